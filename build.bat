@@ -1 +1,3 @@
-gcc -std=c11 -Wall -pedantic -Iinclude -Llib -DCURL_STATICLIB loldownloader.c inflate.c -lcurl -lz -lws2_32 -o loldl.exe -Os -s
+gcc -std=c11 -Wall -pedantic -Iinclude -DCURL_STATICLIB -c loldl.c inflate.c -Os
+ar rcs libloldl.a loldl.o inflate.o
+gcc -std=c11 -Wall -pedantic -Iinclude -Llib -DCURL_STATICLIB loldownloader.c libloldl.a -lcurl -lz -lws2_32 -o loldl.exe -Os -s
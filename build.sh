@@ -1 +1,6 @@
-gcc -std=c11 -Wall -pedantic -DCURL_STATICLIB loldownloader.c inflate.c -lcurl -lz -o loldl -Os -s
+gcc -std=c11 -Wall -pedantic -DCURL_STATICLIB -c loldl.c inflate.c -Os
+ar rcs libloldl.a loldl.o inflate.o
+gcc -std=c11 -Wall -pedantic -DCURL_STATICLIB loldownloader.c libloldl.a -lcurl -lz -lpthread -o loldl -Os -s
+if pkg-config --exists fuse3; then
+    gcc -std=c11 -Wall -pedantic -DCURL_STATICLIB loldlfs.c libloldl.a $(pkg-config --cflags --libs fuse3) -lcurl -lz -lpthread -o loldlfs -Os -s
+fi
@@ -85,3 +85,52 @@ int inf(FILE *source, FILE *dest)
     (void)inflateEnd(&strm);
     return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
 }
+
+/* Decompress from the memory buffer source until stream ends or the end of
+   the buffer, passing the decompressed data to write() one chunk at a time.
+   write() returns zero on failure. inf_buffer() returns the same values as
+   inf(), Z_ERRNO meaning that write() failed. */
+int inf_buffer(unsigned char *source, unsigned length,
+               int (*write)(unsigned char *data, unsigned length, void *userdata),
+               void *userdata)
+{
+    int ret;
+    unsigned have;
+    z_stream strm;
+    unsigned char out[CHUNK];
+
+    /* allocate inflate state */
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.avail_in = length;
+    strm.next_in = source;
+    ret = inflateInit(&strm);
+    if (ret != Z_OK)
+        return ret;
+
+    /* run inflate() on the whole input until output buffer not full */
+    do {
+        strm.avail_out = CHUNK;
+        strm.next_out = out;
+        ret = inflate(&strm, Z_NO_FLUSH);
+        assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
+        switch (ret) {
+        case Z_NEED_DICT:
+            ret = Z_DATA_ERROR;     /* and fall through */
+        case Z_DATA_ERROR:
+        case Z_MEM_ERROR:
+            (void)inflateEnd(&strm);
+            return ret;
+        }
+        have = CHUNK - strm.avail_out;
+        if (have && !write(out, have, userdata)) {
+            (void)inflateEnd(&strm);
+            return Z_ERRNO;
+        }
+    } while (ret != Z_STREAM_END && (strm.avail_out == 0 || strm.avail_in != 0));
+
+    /* clean up and return */
+    (void)inflateEnd(&strm);
+    return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+}
@@ -0,0 +1,3994 @@
+#ifdef __linux__
+    #define _GNU_SOURCE // fallocate
+#endif
+
+#include "loldl.h"
+
+#include <curl/curl.h>
+#include <zlib.h>
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <Windows.h>
+    #include <fcntl.h>
+    #include <io.h>
+#elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <sys/ioctl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/time.h>
+    #include <unistd.h>
+    #define MAX_PATH 1024
+#endif
+
+#define MAX_LINE_LENGTH 256
+#define MAX_URL_LENGTH 256
+#define MAX_BIN_COUNT 32
+#define PACKAGEMANIFEST_INDEX_MAGIC 0x58444c4c // "LLDX"
+#define PACKAGEMANIFEST_INDEX_VERSION 4
+#define DIGESTS_MAGIC 0x47444c4c // "LLDG"
+#define DIGESTS_VERSION 1
+#define MIN_RATE_LIMIT_BURST (64 * 1024)
+#define TAR_BLOCK_SIZE 512
+#define COALESCE_MAX_GAP (256 * 1024)           // Game files closer than this are fetched with one range request
+#define COALESCE_MAX_RANGE (32 * 1024 * 1024)
+#define SEGMENT_SIZE (4 * 1024 * 1024)          // BIN archives are downloaded in pieces of this size when concurrency adapts
+#define MAX_TRANSFER_ATTEMPTS 3
+#define ADAPT_INTERVAL 2000                     // Milliseconds between two decisions of the concurrency controller
+#define ADAPT_SMOOTHING_FACTOR 0.5
+#define ADAPT_MIN_GAIN 0.05                     // An extra transfer is only kept if it raises throughput by this fraction
+#define ADAPT_RTT_INFLATION 2.0                 // Time to first byte this many times the lowest one means queues are building up
+#define ADAPT_RTT_WINDOW 30000                  // Lowest time to first byte is forgotten after this many milliseconds
+#define ADAPT_MIN_RTT_RISE 50.0                 // Rises of the time to first byte below this many milliseconds are jitter
+#define ADAPT_HOLD_INTERVALS 5                  // Intervals to wait after backing off before probing with an extra transfer again
+#define HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3 0x165667B19E3779F9ULL
+#define HASH_PRIME_4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME_5 0x27D4EB2F165667C5ULL
+
+// Information about a specific game file. Strings are stored with the entry when parsed, or in the index's string table
+typedef struct {
+    char* link;
+    char* fileName;
+    unsigned int BIN;
+    unsigned int offsetInBIN;
+    unsigned int size;
+    int unk;
+    unsigned int index;         // Position in packagemanifest
+} FileEntry;
+
+// Information about a specific BIN archive file that holds many game files
+typedef struct {
+    char* link;
+    char* fileName;
+    unsigned int size;          // Remote size, probed once when packagemanifest is parsed
+} FileArchiveEntry;
+
+typedef struct ListNode_t {
+    union {
+        FileEntry* fileEntry;
+        FileArchiveEntry* fileArchiveEntry;
+    };
+    struct ListNode_t* next;
+} ListNode;
+
+typedef struct {
+    ListNode* head;
+    ListNode* tail;
+} FileList;
+
+// Some stats
+typedef struct {
+    int numFilesInPackageManifest;  // Number of game files counted in packagemanifest
+    int numBINArchives;             // Number of archive files counted in packagemanifest
+    int numBytesFromFileList;       // Sum of game files' sizes
+    int numBytesFromBINArchives;    // Sum of file archives' sizes
+    int maxLineLength;              // Longest line in packagemanifest
+} Statistics;
+
+// Progress data used in function progress_callback
+typedef struct {
+    unsigned int timeOld;                   // Last time speed was measured
+    unsigned int bytesOld;                  // Bytes that had been downloaded when speed was last measured
+    unsigned int avgSpeedInBytesPerSecond;  // "Average" speed used to calculate ETA
+    unsigned int bytesAlreadyDownloaded;    // Bytes that had already been downloaded when the download was resumed
+} ProgressData;
+
+// Validators sent by the server along with packagemanifest, used to make conditional requests on later runs
+typedef struct {
+    char ETag[128];
+    char lastModified[64];
+} ManifestValidators;
+
+// Header of the binary packagemanifest index (packagemanifest.idx). It is followed by numFilesInPackageManifest
+// FileEntryRecord records, numBINArchives FileArchiveEntryRecord records and a string table of stringTableSize bytes,
+// so the whole file can be mapped and its strings used in place
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int sizeOfFileEntryRecord;
+    unsigned int sizeOfFileArchiveEntryRecord;
+    unsigned int stringTableSize;
+    unsigned int packagemanifestSize;   // Size of the packagemanifest the index was built from
+    char ETag[128];                     // ETag of the packagemanifest the index was built from (may be empty)
+    char downloadURL[64];               // Links and file names stored in the records depend on these options
+    char downloadPath[64];
+    char gameVersion[64];
+    char destFolder[160];
+    Statistics stats;
+} PackageManifestIndexHeader;
+
+// Records of the index, strings are offsets in its string table
+typedef struct {
+    unsigned int link;
+    unsigned int fileName;
+    unsigned int BIN;
+    unsigned int offsetInBIN;
+    unsigned int size;
+    int unk;
+} FileEntryRecord;
+
+typedef struct {
+    unsigned int link;
+    unsigned int fileName;
+    unsigned int size;
+} FileArchiveEntryRecord;
+
+typedef enum {
+    TRANSFER_BIN_ARCHIVE,
+    TRANSFER_BIN_RANGE,
+    TRANSFER_INDIVIDUAL_FILE
+} TransferType;
+
+struct Scheduler_t;
+
+// A single download handed to the scheduler
+typedef struct {
+    TransferType type;
+    union {
+        FileEntry* fileEntry;
+        FileArchiveEntry* fileArchiveEntry;
+    };
+    char* link;
+    char* fileName;
+    unsigned int size;              // Bytes that have to be downloaded
+    unsigned int resumeFrom;        // Bytes already on disk
+    unsigned int bytesReceived;
+    unsigned int index;             // Position in the order transfers were queued
+    bool hasRange;                  // Only download size bytes starting at rangeStart
+    unsigned int rangeStart;
+    bool paused;                    // Paused by the rate limiter
+    bool done;                      // Finished successfully
+    int attempts;                   // Failed attempts so far
+    unsigned int retryAt;           // Time the next attempt may start
+    FILE* destFile;
+    size_t (*sink)(char* data, size_t length, void* sinkData); // Receives the data instead of destFile when set
+    void* sinkData;
+    CURL* handle;
+    struct Scheduler_t* scheduler;
+} Transfer;
+
+// Decides which queued transfers start first (qsort comparator on Transfer)
+typedef struct SchedulingPolicy_t {
+    char* name;
+    int (*compare)(const void* a, const void* b);
+} SchedulingPolicy;
+
+// Snapshot of the scheduler state, for monitoring
+typedef struct {
+    int queueDepth;                 // Transfers not started yet
+    unsigned int queuedBytes;
+    int inFlightTransfers;
+    unsigned int inFlightBytes;     // Bytes still to be received by the running transfers
+    unsigned int bytesReceived;     // Bytes received by all transfers so far
+    unsigned int bytesTotal;        // Bytes of all queued transfers
+    unsigned int rateLimit;
+    int transferLimit;              // Transfers allowed in flight right now
+} SchedulerStats;
+
+// Adapts the number of transfers in flight to the network, AIMD style: one more transfer at a time while that
+// raises aggregate throughput, half as many when transfers fail and a quarter less when the time to first byte
+// shows that queues are building up (bufferbloat, or a CDN holding back requests)
+typedef struct {
+    bool enabled;
+    int limit;                      // Transfers allowed in flight
+    int maxLimit;
+    unsigned int timeLastDecision;
+    unsigned int timeLastDecrease;
+    unsigned int bytesLastDecision;
+    double throughput;              // Bytes per second, smoothed
+    double throughputBeforeIncrease; // Throughput measured before the last increase, 0 if the last decision wasn't one
+    double rtt;                     // Time to first byte in milliseconds, smoothed
+    double minRtt;                  // Lowest time to first byte seen within ADAPT_RTT_WINDOW
+    unsigned int timeMinRtt;
+    int rttSamples;                 // Times to first byte measured since the last decision
+    int errors;                     // Failed attempts since the last decision
+    int hold;                       // Intervals left before probing again
+} ConcurrencyController;
+
+// Runs queued transfers in parallel, in the order given by its policy and within a global rate limit.
+// Rate limiting is a token bucket: transfers consume tokens as they receive data and get paused when
+// there are none left, until the bucket is refilled
+typedef struct Scheduler_t {
+    CURLM* multi;
+    Transfer* queue;                // Sorted by policy once transfers start
+    int queueLength;
+    int queueCapacity;
+    int next;                       // Next transfer in queue to be started
+    Transfer** active;              // Transfers in flight, maxTransfers slots
+    int numActive;
+    int maxTransfers;
+    Transfer** retries;             // Failed transfers waiting for another attempt
+    int numRetries;
+    ConcurrencyController controller;
+    SchedulingPolicy* policy;
+    unsigned int rateLimit;         // Bytes per second, 0 means unlimited
+    double tokens;
+    unsigned int timeLastRefill;
+    unsigned int timeLastRateLimitCheck;
+    unsigned int bytesReceived;
+    unsigned int bytesTotal;
+    ProgressData progressData;
+    bool outOfMemory;               // Some transfers couldn't be queued, so none are run
+    LolDLSession* session;
+} Scheduler;
+
+// Splits the bytes of a BIN archive (or of an individual file) into game files as they arrive, and passes
+// each one to emit as soon as it is complete. Only the compressed bytes of the game file being received, and
+// of the one before it that game files sharing bytes with it are built from, are kept in memory
+typedef struct {
+    FileEntry** entries;            // Game files in the BIN, sorted by offset
+    int numEntries;
+    int current;                    // Game file being received
+    unsigned int position;          // Offset in the BIN of the next byte that arrives
+    unsigned char* buffer;          // Compressed bytes of the current game file
+    unsigned int buffered;
+    unsigned char* previous;        // Compressed bytes of the emitted game file that ends at position, if any
+    unsigned int previousStart;     // Offset in the BIN of previous
+    bool (*emit)(LolDLSession* session, FileEntry* entry, unsigned char* data); // Returns false to stop the feed
+    LolDLSession* session;
+} EntryFeed;
+
+// Digest of a game file after decompressing, recorded when it is written
+typedef struct {
+    unsigned long long hash;
+    unsigned int size;
+    unsigned int valid;
+} Digest;
+
+// Header of packagemanifest.digests, followed by numFiles Digest records in packagemanifest order
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int packagemanifestSize;   // Size of the packagemanifest the digests belong to
+    unsigned int numFiles;
+    char ETag[128];
+} DigestsHeader;
+
+typedef struct {
+    void (*work)(void* data);
+    void* data;
+} ThreadStart;
+
+// Game files shared by the threads that verify them
+typedef struct {
+    FileEntry** entries;
+    int numEntries;
+    atomic_int next;                // Next game file to be verified
+    atomic_int numVerified;
+    bool* damaged;
+    LolDLSession* session;
+} VerifyJob;
+
+// ustar header, one TAR_BLOCK_SIZE block
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char padding[12];
+} TarHeader;
+
+// A read-only view of a whole file in memory
+typedef struct {
+    void* data;
+    size_t size;
+    #ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+    #endif
+} MappedFile;
+
+static int compare_largest_first(const void* a, const void* b);
+static int compare_smallest_first(const void* a, const void* b);
+static int compare_manifest_order(const void* a, const void* b);
+
+// Available scheduling policies, the first one is the default
+static SchedulingPolicy g_schedulingPolicies[] = {{"largest",   compare_largest_first},   // Big transfers don't start last and dominate the tail
+                                                  {"smallest",  compare_smallest_first},
+                                                  {"manifest",  compare_manifest_order}};
+
+// A game version and the game files of its packagemanifest. A session handles several when options.gameVersion
+// is a list, each one in its own folder in options.destFolder
+typedef struct {
+    char gameVersion[64];
+    char destFolder[160];
+    FileList fileList;
+    FileList fileArchiveList;
+    bool ownsEntries;                       // Entries were allocated one by one when parsing, instead of loaded from the index
+    Statistics stats;
+    MappedFile packagemanifestIndex;        // Stays mapped for the whole session when the cached index is used, entries point into it
+    FileEntry* indexFileEntries;            // All entries loaded from the index
+    FileArchiveEntry* indexFileArchiveEntries;
+    Digest* digests;                        // Indexed by FileEntry index, 0 when digests aren't recorded
+    char digestsPath[MAX_PATH];
+    unsigned int packagemanifestSize;
+    ManifestValidators validators;
+} Release;
+
+// A game file of one of the session's releases
+typedef struct {
+    FileEntry* entry;
+    Release* release;
+    bool exists;                            // Its final file is already there
+} GameFileCopy;
+
+// Missing game files of several releases with the same content identity: the same path in packagemanifest (it
+// names the release the file last changed in, so it stays the same while the file doesn't change) and the same
+// size. Their bytes are downloaded once, as the first copy, and written to all of them
+typedef struct {
+    GameFileCopy* copies;
+    int numCopies;
+} SharedGameFile;
+
+#ifdef _WIN32
+    typedef CRITICAL_SECTION Mutex;
+    typedef HANDLE Thread;
+#elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+    typedef pthread_mutex_t Mutex;
+    typedef pthread_t Thread;
+#endif
+
+// Shared by all sessions created from it
+struct LolDLContext_t {
+    CURLSH* share;                          // DNS and TLS session caches
+    Mutex shareLocks[CURL_LOCK_DATA_LAST];
+};
+
+// Everything a single download needs, so sessions don't interfere with each other
+struct LolDLSession_t {
+    LolDLContext* context;
+    LolDLOptions options;
+    SchedulingPolicy* schedulingPolicy;
+    CURL* curl;                             // Used for packagemanifest and for probing sizes
+    Release* releases;                      // One per game version in options.gameVersion
+    int numReleases;
+    Release* release;                       // Game version being worked on
+    ProgressData progressData;
+    int progressColumns;                    // Columns used by the last progress line, so it can be cleared
+    int extractionColumns;
+    Scheduler scheduler;
+    SharedGameFile* sharedGameFiles;        // Sorted by the entry of their first copy, while several releases are downloaded
+    int numSharedGameFiles;
+    FileEntry** fileEntries;                // Game files by index, for fetching them one by one in lazy sessions
+    CURL** fetchHandles;                    // Idle handles of loldl_session_fetch_file, so connections are kept alive
+    int numFetchHandles;
+    int fetchHandlesCapacity;
+    bool fetchedDigests;                    // A fetch recorded a digest that isn't saved yet
+    LolDLResult error;                      // First error, only touched by the session's thread
+    atomic_bool cancelled;
+    atomic_uint rateLimit;                  // Set by loldl_session_set_rate_limit and from options.rateLimitFile
+    long long rateLimitFromFile;            // Last value read from options.rateLimitFile in bytes per second, -1 before that
+    ThreadStart threadStart;
+    Thread thread;
+    bool started;
+    bool joined;
+    // Shared between the session's thread and the one polling it, guarded by mutex
+    Mutex mutex;
+    LolDLProgress progress;
+    LolDLResult result;
+    bool finished;
+    // Only touched by the thread polling the session
+    LolDLProgress reportedProgress;
+    LolDLProgressCallback progressCallback;
+    LolDLCompletionCallback completionCallback;
+    void* userdata;
+};
+
+// Externally defined inflate (decompress) function
+int inf_buffer(unsigned char *source, unsigned length, int (*write)(unsigned char *data, unsigned length, void *userdata), void *userdata);
+
+// Returns false if there isn't enough memory
+static bool list_add(FileList* l, void* data)
+{
+    ListNode* node = malloc(sizeof(ListNode));
+    if (!node) {
+        return false;
+    }
+    node->next = 0;
+    node->fileEntry = (FileEntry*)data;
+    
+    if (!l->head) {
+        l->head = node;
+    }
+    
+    if (l->tail) {
+        l->tail->next = node;
+    }
+    l->tail = node;
+    return true;
+}
+
+#ifdef _WIN32
+    static DWORD WINAPI thread_main(LPVOID data)
+#else
+    static void* thread_main(void* data)
+#endif
+{
+    ThreadStart* start = (ThreadStart*)data;
+    start->work(start->data);
+    return 0;
+}
+
+// start has to stay valid until the thread is joined
+static bool thread_create(Thread* thread, ThreadStart* start)
+{
+    #ifdef _WIN32
+        *thread = CreateThread(0, 0, thread_main, start, 0, 0);
+        return *thread != 0;
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        return pthread_create(thread, 0, thread_main, start) == 0;
+    #endif
+}
+
+static void thread_join(Thread thread)
+{
+    #ifdef _WIN32
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        pthread_join(thread, 0);
+    #endif
+}
+
+static void mutex_init(Mutex* mutex)
+{
+    #ifdef _WIN32
+        InitializeCriticalSection(mutex);
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        pthread_mutex_init(mutex, 0);
+    #endif
+}
+
+static void mutex_destroy(Mutex* mutex)
+{
+    #ifdef _WIN32
+        DeleteCriticalSection(mutex);
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        pthread_mutex_destroy(mutex);
+    #endif
+}
+
+static void mutex_lock(Mutex* mutex)
+{
+    #ifdef _WIN32
+        EnterCriticalSection(mutex);
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        pthread_mutex_lock(mutex);
+    #endif
+}
+
+static void mutex_unlock(Mutex* mutex)
+{
+    #ifdef _WIN32
+        LeaveCriticalSection(mutex);
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        pthread_mutex_unlock(mutex);
+    #endif
+}
+
+static void sleep_ms(unsigned int milliseconds)
+{
+    #ifdef _WIN32
+        Sleep(milliseconds);
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        struct timespec ts = {milliseconds / 1000, (milliseconds % 1000) * 1000000L};
+        nanosleep(&ts, 0);
+    #endif
+}
+
+// Start a new stage of the session, its progress starts over
+static void set_stage(LolDLSession* session, LolDLStage stage)
+{
+    mutex_lock(&session->mutex);
+    session->progress = (LolDLProgress){.stage = stage};
+    mutex_unlock(&session->mutex);
+}
+
+// Make the progress of a download visible to the thread polling the session
+static void publish_transfer_progress(LolDLSession* session, ProgressData* progressData, unsigned int bytesTotal, unsigned int bytesDone, int queueDepth, int inFlightTransfers, unsigned int inFlightBytes)
+{
+    mutex_lock(&session->mutex);
+    session->progress.bytesTotal = bytesTotal;
+    session->progress.bytesDone = bytesDone;
+    session->progress.speedInBytesPerSecond = progressData->avgSpeedInBytesPerSecond;
+    session->progress.queueDepth = queueDepth;
+    session->progress.inFlightTransfers = inFlightTransfers;
+    session->progress.inFlightBytes = inFlightBytes;
+    mutex_unlock(&session->mutex);
+}
+
+static void publish_file_progress(LolDLSession* session, int filesTotal, int filesDone)
+{
+    mutex_lock(&session->mutex);
+    session->progress.filesTotal = filesTotal;
+    session->progress.filesDone = filesDone;
+    mutex_unlock(&session->mutex);
+}
+
+// Print like printf, but only if the session prints its output. Returns the number of characters printed
+static int session_print(LolDLSession* session, const char* format, ...)
+{
+    if (!session->options.printOutput) {
+        return 0;
+    }
+    va_list args;
+    va_start(args, format);
+    int count = vprintf(format, args);
+    va_end(args);
+    return count;
+}
+
+// Remember the first error of the session, the ones after it are usually caused by it
+static void set_error(LolDLSession* session, LolDLResult error)
+{
+    if (session->error == LOLDL_OK) {
+        session->error = error;
+    }
+}
+
+// Allocations that grow with the packagemanifest fail the session instead of the host process
+static void set_out_of_memory(LolDLSession* session)
+{
+    session_print(session, "\n[ERROR]: Out of memory\n");
+    set_error(session, LOLDL_ERROR_OUT_OF_MEMORY);
+}
+
+static bool is_cancelled(LolDLSession* session)
+{
+    return atomic_load(&session->cancelled);
+}
+
+static void clear_current_line(LolDLSession* session, int columns)
+{
+    // TODO: This is probably awful, consider changing it
+    session_print(session, "\r");
+    for (int i = 0; i < columns; i++) {
+        session_print(session, " ");
+    }
+}
+
+static void build_progress_string(char* buffer, unsigned int bytesTotal, unsigned int bytesNow)
+{
+    if (bytesTotal < 1024) {
+        // Print B
+        sprintf(buffer, "(%u/%u B)", bytesNow, bytesTotal);
+    } else if (bytesTotal < 1024 * 1024) {
+        // Print KiB
+        sprintf(buffer, "(%.2f/%.2f KiB)", bytesNow / 1024.0, bytesTotal / 1024.0);
+    } else if (bytesTotal < 1024 * 1024 * 1024) {
+        // Print MiB
+        sprintf(buffer, "(%.2f/%.2f MiB)", bytesNow / 1024.0 / 1024.0, bytesTotal / 1024.0 / 1024.0);
+    } else {
+        // Print GiB. Game files or archives probably never reach this size though
+        sprintf(buffer, "(%.2f/%.2f GiB)", bytesNow / 1024.0 / 1024.0 / 1024.0, bytesTotal / 1024.0 / 1024.0 / 1024.0);
+    }
+}
+
+static void build_size_string(char* buffer, unsigned int bytes)
+{
+    if (bytes < 1024) {
+        sprintf(buffer, "%u B", bytes);
+    } else if (bytes < 1024 * 1024) {
+        sprintf(buffer, "%.2f KiB", bytes / 1024.0);
+    } else if (bytes < 1024 * 1024 * 1024) {
+        sprintf(buffer, "%.2f MiB", bytes / 1024.0 / 1024.0);
+    } else {
+        sprintf(buffer, "%.2f GiB", bytes / 1024.0 / 1024.0 / 1024.0);
+    }
+}
+
+static void build_speed_string(char* buffer, unsigned int speedInBytesPerSecond)
+{
+    unsigned int speed = speedInBytesPerSecond;
+    if (speed < 1024) {
+        // Print B/s
+        sprintf(buffer, "%u B/s", speed);
+    } else if (speed < 1024 * 1024) {
+        // Print KiB/s
+        sprintf(buffer, "%u KiB/s", (unsigned int)(speed / 1024.0));
+    } else if (speed < 1024 * 1024 * 1024) {
+        // Print MiB/s
+        sprintf(buffer, "%.1f MiB/s", speed / 1024.0 / 1024.0);
+    } else {
+        // Print GiB/s. Do you even need a progress and speed indicator if your connection is this fast?
+        sprintf(buffer, "%.2f GiB/s", speed / 1024.0 / 1024.0 / 1024.0);
+    }
+}
+
+static void build_ETA_string(char* buffer, unsigned int bytesTotal, unsigned int bytesNow, unsigned int speedInBytesPerSecond)
+{
+    unsigned int remaining = bytesTotal - bytesNow;
+    // Without a speed yet, e.g. right after a transfer starts, there is nothing to estimate from
+    if (remaining && !speedInBytesPerSecond) {
+        strcpy(buffer, "--:--:--");
+        return;
+    }
+    int secondsLeft = speedInBytesPerSecond ? (int)((float)remaining / speedInBytesPerSecond) : 0;
+    
+    sprintf(buffer, "%02d:%02d:%02d", secondsLeft / (60 * 60), (secondsLeft % (60 * 60)) / 60, (secondsLeft % (60 * 60)) % 60);
+}
+
+static void build_progress_bar_string(char* buffer, float percentage, unsigned int maxWidth)
+{
+    static char bar[] = "===================================>";
+    if (maxWidth > sizeof(bar) - 1) {
+        maxWidth = sizeof(bar) - 1;
+    }
+    int index = (int)(maxWidth * percentage);
+    if (!(index >= 0)) {
+        index = 0;
+    } else if (index > maxWidth) {
+        index = maxWidth;
+    }
+    sprintf(buffer, "[%s", &bar[sizeof(bar) - 1 - index]);
+    for (int i = 0; i < (maxWidth - index); i++) {
+        strcat(buffer, " ");
+    }
+    strcat(buffer, "]");
+}
+
+static unsigned int get_time_ms()
+{
+    #ifdef _WIN32
+        return GetTickCount();
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        struct timeval tv;
+        if (gettimeofday(&tv, 0) != 0) {
+            return 0;
+        }
+        return (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+    #endif
+}
+
+static unsigned int get_console_columns()
+{
+    #ifdef _WIN32
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
+        return csbi.srWindow.Right - csbi.srWindow.Left + 1;
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        struct winsize w;
+        ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+        return w.ws_col;
+    #endif
+}
+
+// Print the progress line for a download, followed by extraInfo. It is only updated once per second
+// (and when the download finishes), returns false if it wasn't updated
+static bool print_progress(LolDLSession* session, ProgressData* progressData, unsigned int bytesTotal, unsigned int bytesNow, char* extraInfo)
+{
+    // Calculate download speed every second
+    #define SMOOTHING_FACTOR 0.1
+    unsigned int timeNow = get_time_ms();
+    unsigned int speedInBytesPerSecond;
+    if (progressData->timeOld + 1000 <= timeNow) {
+        progressData->timeOld = timeNow;
+        speedInBytesPerSecond = (unsigned int)(bytesNow - progressData->bytesOld);
+        if (progressData->avgSpeedInBytesPerSecond == 0) {
+            progressData->avgSpeedInBytesPerSecond = speedInBytesPerSecond;
+        }
+        progressData->avgSpeedInBytesPerSecond = SMOOTHING_FACTOR * speedInBytesPerSecond + (1 - SMOOTHING_FACTOR) * progressData->avgSpeedInBytesPerSecond;
+        progressData->bytesOld = bytesNow;
+    } else {
+        if (bytesNow < bytesTotal) {
+            return false;
+        }
+        speedInBytesPerSecond = progressData->avgSpeedInBytesPerSecond;
+    }
+    
+    // Show progress bar and info
+    char buffer[64];
+    clear_current_line(session, session->progressColumns);
+    session->progressColumns = 0;
+    if (bytesTotal < 1.0) {
+        bytesTotal = 1;
+    }
+    float p = ((float)bytesNow / (float)bytesTotal);
+    build_progress_bar_string(buffer, p, get_console_columns() / 4);
+    session->progressColumns += session_print(session, "\r%3d%% %s", (int)(p * 100), buffer);
+    
+    build_progress_string(buffer, bytesTotal, bytesNow);
+    session->progressColumns += session_print(session, " %s", buffer);
+    
+    build_speed_string(buffer, speedInBytesPerSecond);
+    session->progressColumns += session_print(session, " | Speed: %s", buffer);
+    
+    build_ETA_string(buffer, bytesTotal, bytesNow, progressData->avgSpeedInBytesPerSecond);
+    session->progressColumns += session_print(session, " | ETA: %s%s", buffer, extraInfo);
+    
+    fflush(stdout);
+    
+    return true;
+}
+
+static int progress_callback(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow)
+{
+    LolDLSession* session = (LolDLSession*)clientp;
+    ProgressData* progressData = &session->progressData;
+    unsigned int bytesNow = (unsigned int)(float)dlnow + progressData->bytesAlreadyDownloaded;
+    unsigned int bytesTotal = (unsigned int)(float)dltotal + progressData->bytesAlreadyDownloaded;
+    print_progress(session, progressData, bytesTotal, bytesNow, "");
+    publish_transfer_progress(session, progressData, bytesTotal, bytesNow, 0, 0, 0);
+    return is_cancelled(session); // Non-zero aborts the transfer
+}
+
+static size_t discard_write_callback(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    return size * nmemb;
+}
+
+static size_t write_callback(char *ptr, size_t size, size_t nmemb, FILE* destFile)
+{
+    return fwrite(ptr, size, nmemb, destFile);
+}
+
+static unsigned int file_size(FILE *file)
+{
+    // TODO: Maybe change this to a method that is guaranteed to work?
+    unsigned int initialPos = ftell(file);
+    fseek(file, 0, SEEK_END);
+    unsigned int size = ftell(file);
+    fseek(file, initialPos, SEEK_SET);
+    return size;
+}
+
+// Probe the size of a remote file with a HEAD request, its headers go to headerCallback. Returns false if the
+// request failed or the size isn't known
+static bool probe_remote_file(LolDLSession* session, char* URL, curl_write_callback headerCallback, void* headerData, unsigned int* size)
+{
+    curl_easy_setopt(session->curl, CURLOPT_URL, URL);
+    curl_easy_setopt(session->curl, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(session->curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(session->curl, CURLOPT_HEADERFUNCTION, headerCallback);
+    curl_easy_setopt(session->curl, CURLOPT_HEADERDATA, headerData);
+    curl_easy_setopt(session->curl, CURLOPT_HEADER, 0L);
+    session->progressData = (ProgressData){0};
+    CURLcode ret = curl_easy_perform(session->curl);
+    long responseCode = 0;
+    double filesize = -1; // -1 when the server didn't send Content-Length
+    curl_easy_getinfo(session->curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    curl_easy_getinfo(session->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &filesize);
+    
+    // Restore defaults
+    curl_easy_setopt(session->curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(session->curl, CURLOPT_NOBODY, 0L);
+    curl_easy_setopt(session->curl, CURLOPT_HEADERFUNCTION, (void*)0);
+    curl_easy_setopt(session->curl, CURLOPT_HEADERDATA, (void*)0);
+    if (ret != CURLE_OK || responseCode < 200 || responseCode > 299 || filesize < 0 || filesize > UINT_MAX) {
+        return false;
+    }
+    *size = (unsigned int)filesize;
+    return true;
+}
+
+static bool file_size_remote(LolDLSession* session, char* URL, unsigned int* size)
+{
+    return probe_remote_file(session, URL, discard_write_callback, 0, size);
+}
+
+static bool file_exists(char* fileName)
+{
+    FILE* file = fopen(fileName, "rb");
+    bool ret = file != 0;
+    if (file) {
+        fclose(file);
+    }
+    return ret;
+}
+
+static bool map_file(char* fileName, MappedFile* mapped)
+{
+    *mapped = (MappedFile){0};
+    #ifdef _WIN32
+        mapped->file = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+        if (mapped->file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(mapped->file, &size) || size.QuadPart == 0) {
+            CloseHandle(mapped->file);
+            return false;
+        }
+        mapped->size = (size_t)size.QuadPart;
+        // Copy-on-write, so records can be modified in memory without touching the file
+        mapped->mapping = CreateFileMapping(mapped->file, 0, PAGE_WRITECOPY, 0, 0, 0);
+        if (!mapped->mapping) {
+            CloseHandle(mapped->file);
+            return false;
+        }
+        mapped->data = MapViewOfFile(mapped->mapping, FILE_MAP_COPY, 0, 0, 0);
+        if (!mapped->data) {
+            CloseHandle(mapped->mapping);
+            CloseHandle(mapped->file);
+            return false;
+        }
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        int fd = open(fileName, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        mapped->size = (size_t)st.st_size;
+        // Copy-on-write, so records can be modified in memory without touching the file
+        mapped->data = mmap(0, mapped->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped->data == MAP_FAILED) {
+            mapped->data = 0;
+            return false;
+        }
+    #endif
+    return true;
+}
+
+static void unmap_file(MappedFile* mapped)
+{
+    if (!mapped->data) {
+        return;
+    }
+    #ifdef _WIN32
+        UnmapViewOfFile(mapped->data);
+        CloseHandle(mapped->mapping);
+        CloseHandle(mapped->file);
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        munmap(mapped->data, mapped->size);
+    #endif
+    *mapped = (MappedFile){0};
+}
+
+static unsigned long long rotate_left(unsigned long long x, int bits)
+{
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static unsigned long long read_u64(const unsigned char* p)
+{
+    unsigned long long value;
+    memcpy(&value, p, sizeof(value)); // Little-endian hosts only
+    return value;
+}
+
+static unsigned long long hash_round(unsigned long long acc, unsigned long long input)
+{
+    acc += input * HASH_PRIME_2;
+    acc = rotate_left(acc, 31);
+    return acc * HASH_PRIME_1;
+}
+
+static unsigned long long hash_merge_round(unsigned long long acc, unsigned long long value)
+{
+    acc ^= hash_round(0, value);
+    return acc * HASH_PRIME_1 + HASH_PRIME_4;
+}
+
+// XXH64 (seed 0) computed over data given in pieces. Its four independent lanes keep the CPU's pipelines full and
+// vectorize well
+typedef struct {
+    unsigned long long v1, v2, v3, v4;
+    unsigned long long length; // Bytes hashed so far
+    unsigned char buffer[32]; // Bytes that don't fill a stripe yet
+    unsigned int bufferLength;
+} HashState;
+
+static void hash_init(HashState* state)
+{
+    *state = (HashState){0};
+    state->v1 = HASH_PRIME_1 + HASH_PRIME_2;
+    state->v2 = HASH_PRIME_2;
+    state->v3 = 0;
+    state->v4 = 0 - HASH_PRIME_1;
+}
+
+static const unsigned char* hash_stripes(HashState* state, const unsigned char* p, const unsigned char* end)
+{
+    unsigned long long v1 = state->v1, v2 = state->v2, v3 = state->v3, v4 = state->v4;
+    for (; p + 32 <= end; p += 32) {
+        v1 = hash_round(v1, read_u64(p));
+        v2 = hash_round(v2, read_u64(p + 8));
+        v3 = hash_round(v3, read_u64(p + 16));
+        v4 = hash_round(v4, read_u64(p + 24));
+    }
+    state->v1 = v1;
+    state->v2 = v2;
+    state->v3 = v3;
+    state->v4 = v4;
+    return p;
+}
+
+static void hash_update(HashState* state, const unsigned char* data, size_t length)
+{
+    const unsigned char* p = data;
+    const unsigned char* end = data + length;
+    if (length == 0) {
+        return;
+    }
+    state->length += length;
+    if (state->bufferLength) {
+        size_t count = 32 - state->bufferLength;
+        if (count > length) {
+            count = length;
+        }
+        memcpy(state->buffer + state->bufferLength, p, count);
+        state->bufferLength += (unsigned int)count;
+        p += count;
+        if (state->bufferLength < 32) {
+            return;
+        }
+        hash_stripes(state, state->buffer, state->buffer + 32);
+        state->bufferLength = 0;
+    }
+    p = hash_stripes(state, p, end);
+    memcpy(state->buffer, p, end - p);
+    state->bufferLength = (unsigned int)(end - p);
+}
+
+static unsigned long long hash_final(const HashState* state)
+{
+    const unsigned char* p = state->buffer;
+    const unsigned char* end = state->buffer + state->bufferLength;
+    unsigned long long hash;
+    if (state->length >= 32) {
+        hash = rotate_left(state->v1, 1) + rotate_left(state->v2, 7) + rotate_left(state->v3, 12) +
+               rotate_left(state->v4, 18);
+        hash = hash_merge_round(hash, state->v1);
+        hash = hash_merge_round(hash, state->v2);
+        hash = hash_merge_round(hash, state->v3);
+        hash = hash_merge_round(hash, state->v4);
+    } else {
+        hash = HASH_PRIME_5;
+    }
+    hash += state->length;
+    
+    for (; p + 8 <= end; p += 8) {
+        hash ^= hash_round(0, read_u64(p));
+        hash = rotate_left(hash, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+    }
+    if (p + 4 <= end) {
+        unsigned int value;
+        memcpy(&value, p, sizeof(value));
+        hash ^= value * HASH_PRIME_1;
+        hash = rotate_left(hash, 23) * HASH_PRIME_2 + HASH_PRIME_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        hash ^= *p * HASH_PRIME_5;
+        hash = rotate_left(hash, 11) * HASH_PRIME_1;
+    }
+    
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static unsigned long long hash_data(const unsigned char* data, size_t length)
+{
+    HashState state;
+    hash_init(&state);
+    hash_update(&state, data, length);
+    return hash_final(&state);
+}
+
+// Hash a whole file through a memory mapping. Returns false if it doesn't exist
+static bool hash_file(char* fileName, unsigned long long* hash, unsigned int* size)
+{
+    MappedFile mapped;
+    if (map_file(fileName, &mapped)) {
+        *hash = hash_data((unsigned char*)mapped.data, mapped.size);
+        *size = (unsigned int)mapped.size;
+        unmap_file(&mapped);
+        return true;
+    }
+    // Empty files can't be mapped
+    FILE* file = fopen(fileName, "rb");
+    if (!file) {
+        return false;
+    }
+    *size = file_size(file);
+    fclose(file);
+    if (*size != 0) {
+        return false;
+    }
+    *hash = hash_data(0, 0);
+    return true;
+}
+
+static int get_cpu_count()
+{
+    #ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return (int)info.dwNumberOfProcessors;
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        return count > 0 ? (int)count : 1;
+    #endif
+}
+
+// Call work(data) from numThreads threads (the calling one included) and wait until all of them return
+static void run_in_parallel(void (*work)(void* data), void* data, int numThreads)
+{
+    ThreadStart start = {work, data};
+    Thread* threads = malloc(numThreads * sizeof(Thread));
+    int numStarted = 0;
+    while (threads && numStarted < numThreads - 1 && thread_create(&threads[numStarted], &start)) {
+        numStarted++;
+    }
+    work(data);
+    for (int i = 0; i < numStarted; i++) {
+        thread_join(threads[i]);
+    }
+    free(threads);
+}
+
+// Case-insensitive check for an HTTP header name at the start of a header line
+static bool is_header(char* line, size_t lineLength, char* name)
+{
+    size_t nameLength = strlen(name);
+    if (lineLength <= nameLength) {
+        return false;
+    }
+    for (size_t i = 0; i < nameLength; i++) {
+        char c = line[i];
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        if (c != name[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copy the value of a header line, without leading spaces and trailing CRLF
+static void copy_header_value(char* dest, size_t destSize, char* value, size_t valueLength)
+{
+    while (valueLength && *value == ' ') {
+        value++;
+        valueLength--;
+    }
+    while (valueLength && (value[valueLength - 1] == '\r' || value[valueLength - 1] == '\n' || value[valueLength - 1] == ' ')) {
+        valueLength--;
+    }
+    if (valueLength >= destSize) {
+        valueLength = destSize - 1;
+    }
+    memcpy(dest, value, valueLength);
+    dest[valueLength] = '\0';
+}
+
+static size_t validators_header_callback(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    ManifestValidators* validators = (ManifestValidators*)userdata;
+    size_t length = size * nitems;
+    if (is_header(buffer, length, "etag:")) {
+        copy_header_value(validators->ETag, sizeof(validators->ETag), buffer + 5, length - 5);
+    } else if (is_header(buffer, length, "last-modified:")) {
+        copy_header_value(validators->lastModified, sizeof(validators->lastModified), buffer + 14, length - 14);
+    }
+    return length;
+}
+
+static bool read_packagemanifest_validators(char* fileName, ManifestValidators* validators)
+{
+    *validators = (ManifestValidators){0};
+    FILE* file = fopen(fileName, "rb");
+    if (!file) {
+        return false;
+    }
+    char line[MAX_LINE_LENGTH];
+    while (fgets(line, MAX_LINE_LENGTH, file)) {
+        validators_header_callback(line, 1, strlen(line), validators);
+    }
+    fclose(file);
+    return validators->ETag[0] || validators->lastModified[0];
+}
+
+static void write_packagemanifest_validators(LolDLSession* session, char* fileName, ManifestValidators* validators)
+{
+    if (!validators->ETag[0] && !validators->lastModified[0]) {
+        // Server didn't send any validators, freshness can only be checked by size
+        remove(fileName);
+        return;
+    }
+    FILE* file = fopen(fileName, "wb");
+    if (!file) {
+        session_print(session, "[WARNING]: Couldn't write to file: %s\n", fileName);
+        return;
+    }
+    if (validators->ETag[0]) {
+        fprintf(file, "ETag: %s\n", validators->ETag);
+    }
+    if (validators->lastModified[0]) {
+        fprintf(file, "Last-Modified: %s\n", validators->lastModified);
+    }
+    fclose(file);
+}
+
+// Download packagemanifest only if it changed since the validators were stored. The new file is written next to
+// the old one and only replaces it on a 200 response. Returns the HTTP response code (0 if the request failed)
+static long download_packagemanifest_if_modified(LolDLSession* session, char* URL, char* fileName, ManifestValidators* validators)
+{
+    char header[MAX_LINE_LENGTH];
+    struct curl_slist* headers = 0;
+    if (validators->ETag[0]) {
+        sprintf(header, "If-None-Match: %.200s", validators->ETag);
+        headers = curl_slist_append(headers, header);
+    }
+    if (validators->lastModified[0]) {
+        sprintf(header, "If-Modified-Since: %.200s", validators->lastModified);
+        headers = curl_slist_append(headers, header);
+    }
+
+    char tempFileName[MAX_PATH];
+    sprintf(tempFileName, "%.1000s.tmp", fileName);
+    FILE* tempFile = fopen(tempFileName, "wb");
+    if (!tempFile) {
+        session_print(session, "[ERROR]: Couldn't write to file: %s\n", tempFileName);
+        curl_slist_free_all(headers);
+        return 0;
+    }
+
+    // Usually answered with a 304 and no body, which would leave an empty progress line behind
+    ManifestValidators newValidators = {0};
+    curl_easy_setopt(session->curl, CURLOPT_NOPROGRESS, 1L);
+    curl_easy_setopt(session->curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(session->curl, CURLOPT_HEADERFUNCTION, validators_header_callback);
+    curl_easy_setopt(session->curl, CURLOPT_HEADERDATA, (void*)&newValidators);
+    curl_easy_setopt(session->curl, CURLOPT_WRITEDATA, (void*)tempFile);
+    curl_easy_setopt(session->curl, CURLOPT_URL, URL);
+    session->progressData = (ProgressData){0};
+    long responseCode = 0;
+    if (curl_easy_perform(session->curl) == CURLE_OK) {
+        curl_easy_getinfo(session->curl, CURLINFO_RESPONSE_CODE, &responseCode);
+    }
+    fclose(tempFile);
+
+    // Restore defaults
+    curl_easy_setopt(session->curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(session->curl, CURLOPT_HTTPHEADER, (void*)0);
+    curl_easy_setopt(session->curl, CURLOPT_HEADERFUNCTION, (void*)0);
+    curl_easy_setopt(session->curl, CURLOPT_HEADERDATA, (void*)0);
+    curl_slist_free_all(headers);
+
+    if (responseCode == 200) {
+        remove(fileName);
+        rename(tempFileName, fileName);
+        *validators = newValidators;
+    } else {
+        remove(tempFileName);
+    }
+    return responseCode;
+}
+
+static void make_directory(char* dirName)
+{
+    #ifdef _WIN32
+        CreateDirectory(dirName, 0);
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        mkdir(dirName, 0777);
+    #endif
+}
+
+static void make_path(char* path)
+{
+    //printf("Creating path: %s\n", path);
+    char temp[MAX_PATH];
+    strcpy(temp, path);
+    char* slash = strchr(temp, '/');
+    while (slash) {
+        *slash = '\0';
+        make_directory(temp);
+        char* prevSlash = slash;
+        slash = strchr(slash + 1, '/');
+        *prevSlash = '/';
+    }
+    make_directory(temp);
+}
+
+// Final file name of a game file, after decompressing
+static void get_final_file_name(FileEntry* entry, char* finalFileName)
+{
+    strcpy(finalFileName, entry->fileName);
+    char* lastDot = strrchr(finalFileName, '.');
+    if (lastDot) {
+        *lastDot = '\0';
+    }
+}
+
+static void record_digest(Release* release, FileEntry* entry, char* finalFileName)
+{
+    if (release->digests) {
+        Digest* digest = &release->digests[entry->index];
+        digest->valid = hash_file(finalFileName, &digest->hash, &digest->size);
+    }
+}
+
+// A final file being inflated, hashed as it is written so its digest doesn't need reading it back
+typedef struct {
+    FILE* file;
+    HashState hash;
+} InflatedFile;
+
+static int file_write_callback(unsigned char* data, unsigned length, void* userdata)
+{
+    InflatedFile* inflated = (InflatedFile*)userdata;
+    hash_update(&inflated->hash, data, length);
+    return fwrite(data, 1, length, inflated->file) == length;
+}
+
+static void record_inflated_digest(Release* release, FileEntry* entry, InflatedFile* inflated)
+{
+    if (release->digests) {
+        Digest* digest = &release->digests[entry->index];
+        digest->hash = hash_final(&inflated->hash);
+        digest->size = (unsigned int)inflated->hash.length;
+        digest->valid = true;
+    }
+}
+
+// Inflate a game file of release from its length compressed bytes in memory into its final file. Returns false if it
+// couldn't be written
+static bool inflate_game_file(LolDLSession* session, Release* release, FileEntry* entry, unsigned char* data,
+                              unsigned int length)
+{
+    char dir[MAX_PATH];
+    strcpy(dir, entry->fileName);
+    char* lastSlash = strrchr(dir, '/');
+    if (lastSlash) {
+        *lastSlash = '\0';
+        make_path(dir);
+    }
+    
+    char finalFileName[MAX_PATH];
+    get_final_file_name(entry, finalFileName);
+    InflatedFile finalFile;
+    finalFile.file = fopen(finalFileName, "wb");
+    if (!finalFile.file) {
+        session_print(session, "\n[ERROR]: Couldn't write to file: %s\n", finalFileName);
+        set_error(session, LOLDL_ERROR_WRITE);
+        return false;
+    }
+    hash_init(&finalFile.hash);
+    int ret = inf_buffer(data, length, file_write_callback, &finalFile);
+    bool closed = fclose(finalFile.file) == 0;
+    if (ret == Z_ERRNO || !closed) {
+        // e.g. the disk is full. Remove it so it is seen as missing when verifying
+        session_print(session, "\n[ERROR]: Couldn't write to file: %s\n", finalFileName);
+        set_error(session, LOLDL_ERROR_WRITE);
+        remove(finalFileName);
+        return false;
+    }
+    if (ret != Z_OK) {
+        session_print(session, "\n[ERROR]: Couldn't decompress file: %s\n", finalFileName);
+        set_error(session, LOLDL_ERROR_DOWNLOAD);
+        remove(finalFileName);
+        return false;
+    }
+    record_inflated_digest(release, entry, &finalFile);
+    return true;
+}
+
+// Emits a game file of the release being worked on, the feed always goes on
+static bool write_game_file(LolDLSession* session, FileEntry* entry, unsigned char* data)
+{
+    inflate_game_file(session, session->release, entry, data, entry->size);
+    return true;
+}
+
+// Copy the final file of a game file to another release that has the same game file, along with its digest
+static void copy_game_file(LolDLSession* session, GameFileCopy* from, GameFileCopy* to)
+{
+    char fromFileName[MAX_PATH];
+    char toFileName[MAX_PATH];
+    get_final_file_name(from->entry, fromFileName);
+    get_final_file_name(to->entry, toFileName);
+    char dir[MAX_PATH];
+    strcpy(dir, toFileName);
+    char* lastSlash = strrchr(dir, '/');
+    if (lastSlash) {
+        *lastSlash = '\0';
+        make_path(dir);
+    }
+    
+    FILE* fromFile = fopen(fromFileName, "rb");
+    FILE* toFile = fopen(toFileName, "wb");
+    bool ok = fromFile && toFile;
+    char buffer[CURL_MAX_WRITE_SIZE];
+    size_t length;
+    while (ok && (length = fread(buffer, 1, sizeof(buffer), fromFile))) {
+        ok = fwrite(buffer, 1, length, toFile) == length;
+    }
+    ok = ok && !ferror(fromFile);
+    if (fromFile) {
+        fclose(fromFile);
+    }
+    if (toFile) {
+        fclose(toFile);
+    }
+    if (!ok) {
+        session_print(session, "\n[ERROR]: Couldn't copy %s to %s\n", fromFileName, toFileName);
+        set_error(session, LOLDL_ERROR_WRITE);
+        remove(toFileName);
+        return;
+    }
+    if (from->release->digests && from->release->digests[from->entry->index].valid && to->release->digests) {
+        to->release->digests[to->entry->index] = from->release->digests[from->entry->index];
+    } else {
+        record_digest(to->release, to->entry, toFileName);
+    }
+}
+
+static void extract_from_BIN_file(LolDLSession* session, FileEntry *entry, FILE* BINFile, char* BINFileName)
+{
+    fseek(BINFile, entry->offsetInBIN, SEEK_SET);
+    unsigned char* temp = malloc(entry->size ? entry->size : 1);
+    if (!temp) {
+        session_print(session, "[ERROR]: Couldn't allocate memory to extract file: %s\n", entry->fileName);
+        set_error(session, LOLDL_ERROR_OUT_OF_MEMORY);
+        return;
+    }
+    if (fread(temp, 1, entry->size, BINFile) != entry->size) {
+        session_print(session, "[ERROR]: Couldn't read from BIN file: %s\n", BINFileName);
+        set_error(session, LOLDL_ERROR_MISSING_BIN);
+        free(temp);
+        return;
+    }
+    write_game_file(session, entry, temp);
+    free(temp);
+}
+
+// Returns false if the BIN file of the game file isn't there
+static bool extract_from_BIN(LolDLSession* session, FileEntry *entry)
+{
+    char BINFileName[MAX_PATH];
+    sprintf(BINFileName, "%s/BIN_0x%08x", session->release->destFolder, entry->BIN);
+    FILE* BINFile = fopen(BINFileName, "rb");
+    if (!BINFile) {
+        session_print(session, "[ERROR]: BIN file not found: %s\n", BINFileName);
+        set_error(session, LOLDL_ERROR_MISSING_BIN);
+        return false;
+    }
+    extract_from_BIN_file(session, entry, BINFile, BINFileName);
+    fclose(BINFile);
+    return true;
+}
+
+// Release the disk space used by a region of a file without changing its size. Returns false if it isn't supported
+static bool punch_hole(FILE* file, unsigned int offset, unsigned int length)
+{
+    #ifdef __linux__
+        return fallocate(fileno(file), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length) == 0;
+    #else
+        return false;
+    #endif
+}
+
+static bool truncate_file(char* fileName, unsigned int size)
+{
+    #ifdef _WIN32
+        FILE* file = fopen(fileName, "r+b");
+        if (!file) {
+            return false;
+        }
+        bool ret = _chsize_s(_fileno(file), size) == 0;
+        fclose(file);
+        return ret;
+    #elif defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+        return truncate(fileName, size) == 0;
+    #endif
+}
+
+// A BIN archive downloaded in segments can have holes that its size doesn't show. This marker exists next to
+// it until the archive has been cut back to the bytes received without gaps
+static void get_segments_marker_name(FileArchiveEntry* entry, char* markerName)
+{
+    sprintf(markerName, "%s.segments", entry->fileName);
+}
+
+// A BIN archive that had space released while extracting keeps its size but reads zeros in the released
+// regions. This marker is created before the first region is released and removed together with the archive
+static void get_punched_marker_name(char* BINFileName, char* markerName)
+{
+    sprintf(markerName, "%s.punched", BINFileName);
+}
+
+static int compare_BIN_offset(const void* a, const void* b)
+{
+    const FileEntry* e1 = *(const FileEntry**)a;
+    const FileEntry* e2 = *(const FileEntry**)b;
+    if (e1->BIN != e2->BIN) {
+        return e1->BIN < e2->BIN ? -1 : 1;
+    }
+    return (e1->offsetInBIN > e2->offsetInBIN) - (e1->offsetInBIN < e2->offsetInBIN);
+}
+
+static void print_extraction_progress(LolDLSession* session, int i)
+{
+    char buffer[64];
+    clear_current_line(session, session->extractionColumns);
+    float percentage = ((float)i / (float)session->release->stats.numFilesInPackageManifest);    
+    build_progress_bar_string(buffer, percentage, get_console_columns() / 4);
+    session->extractionColumns = session_print(session, "\r%3d%% %s (%d/%d)", (int)(percentage * 100), buffer, i, session->release->stats.numFilesInPackageManifest);
+    fflush(stdout);
+    publish_file_progress(session, session->release->stats.numFilesInPackageManifest, i);
+}
+
+// Extract game files one BIN at a time in offset order, releasing the regions that were already extracted
+// and removing each BIN right after its last game file, so peak disk usage stays close to the final size
+static void extract_from_BIN_files_releasing_space(LolDLSession* session)
+{
+    FileEntry** entries = malloc((session->release->stats.numFilesInPackageManifest + 1) * sizeof(FileEntry*));
+    if (!entries) {
+        set_out_of_memory(session);
+        return;
+    }
+    int numEntries = 0;
+    for (ListNode* c = session->release->fileList.head; c; c = c->next) {
+        entries[numEntries++] = c->fileEntry;
+    }
+    qsort(entries, numEntries, sizeof(FileEntry*), compare_BIN_offset);
+    
+    bool canPunchHoles = true;
+    int first = 0;
+    while (first < numEntries) {
+        char BINFileName[MAX_PATH];
+        sprintf(BINFileName, "%s/BIN_0x%08x", session->release->destFolder, entries[first]->BIN);
+        FILE* BINFile = fopen(BINFileName, "r+b");
+        if (!BINFile) {
+            session_print(session, "[ERROR]: BIN file not found: %s\n", BINFileName);
+            set_error(session, LOLDL_ERROR_MISSING_BIN);
+            break;
+        }
+        
+        char markerName[MAX_PATH + 16];
+        get_punched_marker_name(BINFileName, markerName);
+        bool hasMarker = false;
+        unsigned int releasedUpTo = 0;
+        int last;
+        for (last = first; last < numEntries && entries[last]->BIN == entries[first]->BIN && !is_cancelled(session); last++) {
+            FileEntry* entry = entries[last];
+            print_extraction_progress(session, last + 1);
+            extract_from_BIN_file(session, entry, BINFile, BINFileName);
+            
+            // Release everything before the next game file, gaps between game files included. Game files can
+            // overlap, so the end of this one may still be needed by the next one
+            unsigned int end = entry->offsetInBIN + entry->size;
+            if (last + 1 < numEntries && entries[last + 1]->BIN == entry->BIN) {
+                end = entries[last + 1]->offsetInBIN;
+            }
+            if (canPunchHoles && !hasMarker) {
+                FILE* marker = fopen(markerName, "wb");
+                hasMarker = marker && fclose(marker) == 0;
+                if (!hasMarker) {
+                    session_print(session, "\n[WARNING]: Couldn't write to file: %s, BIN files will be removed after extracting each one\n", markerName);
+                    canPunchHoles = false;
+                }
+            }
+            if (canPunchHoles && end > releasedUpTo) {
+                if (!punch_hole(BINFile, releasedUpTo, end - releasedUpTo)) {
+                    session_print(session, "\n[WARNING]: Can't release space of BIN files on this system, they will be removed after extracting each one\n");
+                    canPunchHoles = false;
+                }
+                releasedUpTo = end;
+            }
+        }
+        
+        fclose(BINFile);
+        if (is_cancelled(session)) {
+            // Game files that weren't extracted yet are still in it, the marker stays so it isn't trusted as complete
+            set_error(session, LOLDL_ERROR_CANCELLED);
+            break;
+        }
+        remove(BINFileName);
+        remove(markerName);
+        first = last;
+    }
+    free(entries);
+}
+
+static int compare_largest_first(const void* a, const void* b)
+{
+    const Transfer* t1 = (const Transfer*)a;
+    const Transfer* t2 = (const Transfer*)b;
+    if (t1->size != t2->size) {
+        return t1->size < t2->size ? 1 : -1;
+    }
+    return compare_manifest_order(a, b);
+}
+
+static int compare_smallest_first(const void* a, const void* b)
+{
+    const Transfer* t1 = (const Transfer*)a;
+    const Transfer* t2 = (const Transfer*)b;
+    if (t1->size != t2->size) {
+        return t1->size < t2->size ? -1 : 1;
+    }
+    return compare_manifest_order(a, b);
+}
+
+static int compare_manifest_order(const void* a, const void* b)
+{
+    const Transfer* t1 = (const Transfer*)a;
+    const Transfer* t2 = (const Transfer*)b;
+    return (t1->index > t2->index) - (t1->index < t2->index);
+}
+
+static SchedulingPolicy* find_scheduling_policy(const char* name)
+{
+    for (int i = 0; i < sizeof(g_schedulingPolicies) / sizeof(g_schedulingPolicies[0]); i++) {
+        if (!strcmp(g_schedulingPolicies[i].name, name)) {
+            return &g_schedulingPolicies[i];
+        }
+    }
+    return 0;
+}
+
+// With maxAdaptiveTransfers, the number of transfers in flight starts at maxTransfers and adapts between 1 and
+// maxAdaptiveTransfers, otherwise it stays at maxTransfers
+static void scheduler_init(Scheduler* scheduler, LolDLSession* session, int maxTransfers, int maxAdaptiveTransfers, unsigned int rateLimit, SchedulingPolicy* policy)
+{
+    *scheduler = (Scheduler){0};
+    scheduler->session = session;
+    scheduler->multi = curl_multi_init();
+    scheduler->maxTransfers = maxTransfers < 1 ? 1 : maxTransfers;
+    if (maxAdaptiveTransfers > 0) {
+        scheduler->controller.enabled = true;
+        scheduler->controller.limit = scheduler->maxTransfers < maxAdaptiveTransfers ? scheduler->maxTransfers : maxAdaptiveTransfers;
+        scheduler->controller.maxLimit = maxAdaptiveTransfers;
+        scheduler->maxTransfers = maxAdaptiveTransfers;
+    }
+    scheduler->active = calloc(scheduler->maxTransfers, sizeof(Transfer*));
+    if (!scheduler->active) {
+        scheduler->outOfMemory = true;
+        set_out_of_memory(session);
+    }
+    scheduler->policy = policy;
+    scheduler->rateLimit = rateLimit;
+    scheduler->timeLastRefill = get_time_ms();
+    // Reuse connections between transfers to the same host
+    curl_multi_setopt(scheduler->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)scheduler->maxTransfers);
+}
+
+static void scheduler_cleanup(Scheduler* scheduler)
+{
+    curl_multi_cleanup(scheduler->multi);
+    free(scheduler->active);
+    free(scheduler->retries);
+    free(scheduler->queue);
+    *scheduler = (Scheduler){0};
+}
+
+static void scheduler_set_rate_limit(Scheduler* scheduler, unsigned int rateLimit)
+{
+    // Tokens above the new burst size are dropped on the next refill. Without a limit no tokens were spent,
+    // so a new limit starts from an empty bucket
+    if (!scheduler->rateLimit) {
+        scheduler->tokens = 0;
+    }
+    scheduler->rateLimit = rateLimit;
+}
+
+static void scheduler_get_stats(Scheduler* scheduler, SchedulerStats* stats)
+{
+    *stats = (SchedulerStats){0};
+    stats->queueDepth = scheduler->queueLength - scheduler->next;
+    for (int i = scheduler->next; i < scheduler->queueLength; i++) {
+        stats->queuedBytes += scheduler->queue[i].size;
+    }
+    stats->inFlightTransfers = scheduler->numActive;
+    for (int i = 0; i < scheduler->numActive; i++) {
+        stats->inFlightBytes += scheduler->active[i]->size - scheduler->active[i]->bytesReceived;
+    }
+    stats->bytesReceived = scheduler->bytesReceived;
+    stats->bytesTotal = scheduler->bytesTotal;
+    stats->rateLimit = scheduler->rateLimit;
+    stats->transferLimit = scheduler->controller.enabled ? scheduler->controller.limit : scheduler->maxTransfers;
+}
+
+// Returns 0 if there isn't enough memory, the scheduler then won't run any transfer
+static Transfer* scheduler_add(Scheduler* scheduler, TransferType type, void* entry, char* link, char* fileName, unsigned int size, unsigned int resumeFrom)
+{
+    if (scheduler->outOfMemory) {
+        return 0;
+    }
+    if (scheduler->queueLength == scheduler->queueCapacity) {
+        int capacity = scheduler->queueCapacity ? scheduler->queueCapacity * 2 : 64;
+        Transfer* queue = realloc(scheduler->queue, capacity * sizeof(Transfer));
+        if (!queue) {
+            scheduler->outOfMemory = true;
+            set_out_of_memory(scheduler->session);
+            return 0;
+        }
+        scheduler->queue = queue;
+        scheduler->queueCapacity = capacity;
+    }
+    Transfer* transfer = &scheduler->queue[scheduler->queueLength];
+    *transfer = (Transfer){.type        = type,
+                           .fileEntry   = (FileEntry*)entry,
+                           .link        = link,
+                           .fileName    = fileName,
+                           .size        = size - resumeFrom,
+                           .resumeFrom  = resumeFrom,
+                           .index       = scheduler->queueLength,
+                           .scheduler   = scheduler};
+    scheduler->queueLength++;
+    scheduler->bytesTotal += transfer->size;
+    return transfer;
+}
+
+// Feed the time between sending the request and receiving the first byte to the concurrency controller
+static void scheduler_sample_rtt(Scheduler* scheduler, Transfer* transfer)
+{
+    ConcurrencyController* controller = &scheduler->controller;
+    curl_off_t preTransfer = 0, startTransfer = 0;
+    if (!controller->enabled ||
+        curl_easy_getinfo(transfer->handle, CURLINFO_PRETRANSFER_TIME_T, &preTransfer) != CURLE_OK ||
+        curl_easy_getinfo(transfer->handle, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer) != CURLE_OK) {
+        return;
+    }
+    double rtt = (startTransfer - preTransfer) / 1000.0;
+    unsigned int timeNow = get_time_ms();
+    if (controller->minRtt == 0 || rtt <= controller->minRtt || controller->timeMinRtt + ADAPT_RTT_WINDOW <= timeNow) {
+        controller->minRtt = rtt > 0.1 ? rtt : 0.1;
+        controller->timeMinRtt = timeNow;
+    }
+    if (controller->rtt == 0) {
+        controller->rtt = rtt;
+    }
+    controller->rtt = ADAPT_SMOOTHING_FACTOR * rtt + (1 - ADAPT_SMOOTHING_FACTOR) * controller->rtt;
+    controller->rttSamples++;
+}
+
+static size_t transfer_write_callback(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    Transfer* transfer = (Transfer*)userdata;
+    Scheduler* scheduler = transfer->scheduler;
+    size_t length = size * nmemb;
+    if (scheduler->rateLimit && scheduler->tokens <= 0) {
+        // Out of tokens, curl will deliver this data again when the transfer is resumed
+        transfer->paused = true;
+        return CURL_WRITEFUNC_PAUSE;
+    }
+    if (transfer->hasRange && transfer->bytesReceived == 0) {
+        // A server that ignores the range would send the whole file from the start
+        long responseCode = 0;
+        curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &responseCode);
+        if (responseCode != 206) {
+            return 0;
+        }
+    }
+    if (transfer->bytesReceived == 0) {
+        scheduler_sample_rtt(scheduler, transfer);
+    }
+    if (scheduler->rateLimit) {
+        scheduler->tokens -= length;
+    }
+    transfer->bytesReceived += length;
+    scheduler->bytesReceived += length;
+    if (transfer->sink) {
+        return transfer->sink(ptr, length, transfer->sinkData);
+    }
+    return fwrite(ptr, 1, length, transfer->destFile);
+}
+
+static bool scheduler_start_transfer(Scheduler* scheduler, Transfer* transfer)
+{
+    LolDLSession* session = scheduler->session;
+    if (!transfer->sink && transfer->hasRange) {
+        // Segment of a BIN archive, written in place
+        transfer->destFile = fopen(transfer->fileName, "r+b");
+        if (transfer->destFile && fseek(transfer->destFile, transfer->rangeStart, SEEK_SET) != 0) {
+            fclose(transfer->destFile);
+            transfer->destFile = 0;
+        }
+    } else if (!transfer->sink) {
+        transfer->destFile = fopen(transfer->fileName, transfer->resumeFrom ? "ab" : "wb");
+    }
+    if (!transfer->sink && !transfer->destFile) {
+        session_print(session, "[ERROR]: Couldn't write to file: %s\n", transfer->fileName);
+        set_error(session, LOLDL_ERROR_WRITE);
+        return false;
+    }
+    transfer->handle = curl_easy_init();
+    curl_easy_setopt(transfer->handle, CURLOPT_SHARE, session->context->share);
+    curl_easy_setopt(transfer->handle, CURLOPT_URL, transfer->link);
+    curl_easy_setopt(transfer->handle, CURLOPT_WRITEFUNCTION, transfer_write_callback);
+    curl_easy_setopt(transfer->handle, CURLOPT_WRITEDATA, (void*)transfer);
+    curl_easy_setopt(transfer->handle, CURLOPT_PRIVATE, (void*)transfer);
+    curl_easy_setopt(transfer->handle, CURLOPT_FAILONERROR, 1L);
+    if (transfer->resumeFrom) {
+        curl_easy_setopt(transfer->handle, CURLOPT_RESUME_FROM, (long)transfer->resumeFrom);
+    }
+    if (transfer->hasRange) {
+        char range[32];
+        sprintf(range, "%u-%u", transfer->rangeStart, transfer->rangeStart + transfer->size - 1);
+        curl_easy_setopt(transfer->handle, CURLOPT_RANGE, range);
+    }
+    curl_multi_add_handle(scheduler->multi, transfer->handle);
+    scheduler->active[scheduler->numActive++] = transfer;
+    return true;
+}
+
+static void inflate_individual_file(LolDLSession* session, FileEntry* entry)
+{
+    MappedFile compressedFile;
+    if (!map_file(entry->fileName, &compressedFile)) {
+        // Remove the final file too, so it is seen as missing when verifying
+        char finalFileName[MAX_PATH];
+        get_final_file_name(entry, finalFileName);
+        session_print(session, "\n[ERROR]: Couldn't read downloaded file: %s\n", entry->fileName);
+        set_error(session, LOLDL_ERROR_DOWNLOAD);
+        remove(finalFileName);
+        remove(entry->fileName);
+        return;
+    }
+    inflate_game_file(session, session->release, entry, (unsigned char*)compressedFile.data,
+                      (unsigned int)compressedFile.size);
+    unmap_file(&compressedFile);
+    remove(entry->fileName);
+}
+
+static void scheduler_finish_transfer(Scheduler* scheduler, Transfer* transfer, CURLcode result)
+{
+    LolDLSession* session = scheduler->session;
+    long responseCode = 0;
+    curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &responseCode);
+    curl_multi_remove_handle(scheduler->multi, transfer->handle);
+    curl_easy_cleanup(transfer->handle);
+    transfer->handle = 0;
+    if (transfer->destFile) {
+        fclose(transfer->destFile);
+        transfer->destFile = 0;
+    }
+    for (int i = 0; i < scheduler->numActive; i++) {
+        if (scheduler->active[i] == transfer) {
+            scheduler->active[i] = scheduler->active[--scheduler->numActive];
+            break;
+        }
+    }
+    
+    if (result != CURLE_OK) {
+        // A server that is overloaded by too many transfers is no reason to give up on this one, as long as the
+        // controller can still back off
+        bool serverBusy = result == CURLE_HTTP_RETURNED_ERROR && (responseCode == 503 || responseCode == 429)
+                       && scheduler->controller.limit > 1;
+        if (scheduler->controller.enabled && !is_cancelled(session)) {
+            scheduler->controller.errors++;
+        }
+        if (is_cancelled(session)) {
+            set_error(session, LOLDL_ERROR_CANCELLED);
+        } else if (scheduler->controller.enabled && (serverBusy || ++transfer->attempts < MAX_TRANSFER_ATTEMPTS)) {
+            // Failures are expected while the controller probes for the limit of the network or the CDN, so try
+            // again later and continue after the bytes that were already received
+            clear_current_line(session, session->progressColumns);
+            session->progressColumns = 0;
+            session_print(session, "\r[WARNING]: Couldn't download %s: %s, retrying\n", transfer->link, curl_easy_strerror(result));
+            if (transfer->hasRange) {
+                transfer->rangeStart += transfer->bytesReceived;
+            } else {
+                transfer->resumeFrom += transfer->bytesReceived;
+            }
+            transfer->size -= transfer->bytesReceived;
+            transfer->bytesReceived = 0;
+            transfer->paused = false;
+            transfer->retryAt = get_time_ms() + (transfer->attempts > 1 ? transfer->attempts : 1) * 1000;
+            scheduler->retries[scheduler->numRetries++] = transfer;
+            return;
+        } else {
+            clear_current_line(session, session->progressColumns);
+            session->progressColumns = 0;
+            session_print(session, "\r[ERROR]: Couldn't download %s: %s\n", transfer->link, curl_easy_strerror(result));
+            set_error(session, LOLDL_ERROR_DOWNLOAD);
+        }
+        if (transfer->type == TRANSFER_INDIVIDUAL_FILE && !transfer->sink) {
+            // Don't leave an incomplete compressed file behind, it would be inflated on the next run
+            remove(transfer->fileName);
+        }
+        return;
+    }
+    transfer->done = true;
+    if (transfer->type == TRANSFER_INDIVIDUAL_FILE && !transfer->sink) {
+        inflate_individual_file(session, transfer->fileEntry);
+    }
+}
+
+// Refill the token bucket and resume transfers paused by the rate limiter
+static void scheduler_refill_tokens(Scheduler* scheduler)
+{
+    LolDLSession* session = scheduler->session;
+    unsigned int timeNow = get_time_ms();
+    if (session->options.rateLimitFile[0] && scheduler->timeLastRateLimitCheck + 1000 <= timeNow) {
+        // Only a new value in the file replaces the limit, so it doesn't undo loldl_session_set_rate_limit
+        scheduler->timeLastRateLimitCheck = timeNow;
+        FILE* file = fopen(session->options.rateLimitFile, "rb");
+        unsigned int rateLimitInKiB;
+        if (file && fscanf(file, "%u", &rateLimitInKiB) == 1 && rateLimitInKiB * 1024LL != session->rateLimitFromFile) {
+            session->rateLimitFromFile = rateLimitInKiB * 1024LL;
+            atomic_store(&session->rateLimit, rateLimitInKiB * 1024);
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+    unsigned int rateLimit = atomic_load(&session->rateLimit);
+    if (rateLimit != scheduler->rateLimit) {
+        clear_current_line(session, session->progressColumns);
+        session->progressColumns = 0;
+        if (rateLimit) {
+            session_print(session, "\r[INFO]: Rate limit changed to %u KiB/s\n", rateLimit / 1024);
+        } else {
+            session_print(session, "\r[INFO]: Rate limit removed\n");
+        }
+        scheduler_set_rate_limit(scheduler, rateLimit);
+    }
+    
+    if (scheduler->rateLimit) {
+        // Allow bursts of a quarter of a second worth of data, but at least one full write from curl
+        double burst = scheduler->rateLimit / 4.0;
+        if (burst < MIN_RATE_LIMIT_BURST) {
+            burst = MIN_RATE_LIMIT_BURST;
+        }
+        scheduler->tokens += scheduler->rateLimit * ((timeNow - scheduler->timeLastRefill) / 1000.0);
+        if (scheduler->tokens > burst) {
+            scheduler->tokens = burst;
+        }
+    }
+    scheduler->timeLastRefill = timeNow;
+    
+    if (scheduler->rateLimit && scheduler->tokens <= 0) {
+        return;
+    }
+    for (int i = 0; i < scheduler->numActive; i++) {
+        Transfer* transfer = scheduler->active[i];
+        if (transfer->paused) {
+            transfer->paused = false;
+            curl_easy_pause(transfer->handle, CURLPAUSE_CONT);
+        }
+    }
+}
+
+static void scheduler_print_progress(Scheduler* scheduler)
+{
+    SchedulerStats stats;
+    scheduler_get_stats(scheduler, &stats);
+    char inFlight[64];
+    char extraInfo[128];
+    build_size_string(inFlight, stats.inFlightBytes);
+    if (scheduler->controller.enabled) {
+        sprintf(extraInfo, " | Queued: %d | In flight: %d/%d (%s)", stats.queueDepth, stats.inFlightTransfers, stats.transferLimit, inFlight);
+    } else {
+        sprintf(extraInfo, " | Queued: %d | In flight: %d (%s)", stats.queueDepth, stats.inFlightTransfers, inFlight);
+    }
+    print_progress(scheduler->session, &scheduler->progressData, stats.bytesTotal, stats.bytesReceived, extraInfo);
+    publish_transfer_progress(scheduler->session, &scheduler->progressData, stats.bytesTotal, stats.bytesReceived, stats.queueDepth, stats.inFlightTransfers, stats.inFlightBytes);
+}
+
+// Measure aggregate throughput over the last interval and decide how many transfers may be in flight. Failures
+// are acted on right away, but only once per interval since the transfers that were already started when the
+// limit went down can still fail. Every change is printed with the measurements it was based on
+static void scheduler_adapt_concurrency(Scheduler* scheduler)
+{
+    LolDLSession* session = scheduler->session;
+    ConcurrencyController* controller = &scheduler->controller;
+    unsigned int timeNow = get_time_ms();
+    bool backOff = controller->errors && controller->timeLastDecrease + ADAPT_INTERVAL <= timeNow;
+    if (!controller->enabled || (controller->timeLastDecision + ADAPT_INTERVAL > timeNow && !backOff)) {
+        return;
+    }
+    unsigned int elapsed = timeNow - controller->timeLastDecision;
+    double throughput = (scheduler->bytesReceived - controller->bytesLastDecision) * 1000.0 / (elapsed ? elapsed : 1);
+    if (controller->throughput == 0) {
+        controller->throughput = throughput;
+    }
+    controller->throughput = ADAPT_SMOOTHING_FACTOR * throughput + (1 - ADAPT_SMOOTHING_FACTOR) * controller->throughput;
+    controller->timeLastDecision = timeNow;
+    controller->bytesLastDecision = scheduler->bytesReceived;
+    
+    // Only probe when all allowed transfers are busy and more are waiting
+    bool saturated = scheduler->numActive >= controller->limit && (scheduler->next < scheduler->queueLength || scheduler->numRetries);
+    int oldLimit = controller->limit;
+    char* reason = 0;
+    if (backOff) {
+        controller->limit = controller->limit / 2 > 1 ? controller->limit / 2 : 1;
+        controller->hold = ADAPT_HOLD_INTERVALS;
+        reason = "transfers failed";
+    } else if (controller->errors) {
+        // Failures of transfers started before the last decrease
+    } else if (controller->limit > 1 && controller->rttSamples && controller->rtt > ADAPT_RTT_INFLATION * controller->minRtt &&
+               controller->rtt - controller->minRtt > ADAPT_MIN_RTT_RISE) {
+        controller->limit -= controller->limit / 4 > 1 ? controller->limit / 4 : 1;
+        controller->hold = ADAPT_HOLD_INTERVALS;
+        reason = "time to first byte is rising";
+    } else if (controller->throughputBeforeIncrease > 0 && throughput < controller->throughputBeforeIncrease * (1 + ADAPT_MIN_GAIN)) {
+        controller->limit--;
+        controller->hold = ADAPT_HOLD_INTERVALS;
+        reason = "extra transfer didn't raise throughput";
+    } else if (controller->hold > 0) {
+        controller->hold--;
+    } else if (saturated && controller->limit < controller->maxLimit) {
+        controller->limit++;
+        reason = "probing for more throughput";
+    }
+    controller->throughputBeforeIncrease = controller->limit > oldLimit ? throughput : 0;
+    if (controller->limit < oldLimit) {
+        controller->timeLastDecrease = timeNow;
+    }
+    if (reason) {
+        char speed[64];
+        build_speed_string(speed, (unsigned int)throughput);
+        clear_current_line(session, session->progressColumns);
+        session->progressColumns = 0;
+        session_print(session, "\r[INFO]: Parallel downloads %d -> %d, %s (throughput %s, time to first byte %.0f ms, lowest %.0f ms, %d failed)\n",
+                      oldLimit, controller->limit, reason, speed, controller->rtt, controller->minRtt, controller->errors);
+    }
+    controller->errors = 0;
+    controller->rttSamples = 0;
+}
+
+// Returns the next transfer to start: a failed one that is due for another attempt, or the next one in the queue
+static Transfer* scheduler_next_transfer(Scheduler* scheduler)
+{
+    unsigned int timeNow = get_time_ms();
+    for (int i = 0; i < scheduler->numRetries; i++) {
+        Transfer* transfer = scheduler->retries[i];
+        if (transfer->retryAt <= timeNow) {
+            scheduler->retries[i] = scheduler->retries[--scheduler->numRetries];
+            return transfer;
+        }
+    }
+    if (scheduler->next < scheduler->queueLength) {
+        return &scheduler->queue[scheduler->next++];
+    }
+    return 0;
+}
+
+// Run all queued transfers until they finish, or until the session is cancelled
+static void scheduler_run(Scheduler* scheduler)
+{
+    LolDLSession* session = scheduler->session;
+    if (scheduler->outOfMemory) {
+        return;
+    }
+    qsort(scheduler->queue, scheduler->queueLength, sizeof(Transfer), scheduler->policy->compare);
+    scheduler->progressData = (ProgressData){0};
+    scheduler->timeLastRefill = get_time_ms();
+    scheduler->controller.timeLastDecision = scheduler->timeLastRefill;
+    scheduler->controller.bytesLastDecision = scheduler->bytesReceived;
+    // The queue isn't moved anymore, so failed transfers can be referenced until they are retried
+    scheduler->retries = calloc(scheduler->queueLength ? scheduler->queueLength : 1, sizeof(Transfer*));
+    if (!scheduler->retries) {
+        scheduler->outOfMemory = true;
+        set_out_of_memory(session);
+        return;
+    }
+    
+    while (scheduler->next < scheduler->queueLength || scheduler->numActive || scheduler->numRetries) {
+        if (is_cancelled(session)) {
+            while (scheduler->numActive) {
+                scheduler_finish_transfer(scheduler, scheduler->active[0], CURLE_ABORTED_BY_CALLBACK);
+            }
+            break;
+        }
+        int limit = scheduler->controller.enabled ? scheduler->controller.limit : scheduler->maxTransfers;
+        Transfer* transfer;
+        while (scheduler->numActive < limit && (transfer = scheduler_next_transfer(scheduler))) {
+            if (transfer->type == TRANSFER_BIN_ARCHIVE) {
+                clear_current_line(session, session->progressColumns);
+                session->progressColumns = 0;
+                session_print(session, "\r%s: %s\n", transfer->sink ? "Streaming" : "Downloading", transfer->fileName);
+            }
+            if (!scheduler_start_transfer(scheduler, transfer)) {
+                scheduler->bytesTotal -= transfer->size;
+            }
+        }
+        
+        int running;
+        curl_multi_perform(scheduler->multi, &running);
+        CURLMsg* message;
+        int messagesLeft;
+        while ((message = curl_multi_info_read(scheduler->multi, &messagesLeft))) {
+            if (message->msg == CURLMSG_DONE) {
+                Transfer* transfer;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char**)&transfer);
+                scheduler_finish_transfer(scheduler, transfer, message->data.result);
+            }
+        }
+        
+        scheduler_refill_tokens(scheduler);
+        scheduler_adapt_concurrency(scheduler);
+        scheduler_print_progress(scheduler);
+        if (scheduler->numActive || scheduler->numRetries) {
+            curl_multi_poll(scheduler->multi, 0, 0, 100, 0);
+        }
+    }
+    session_print(session, "\n");
+}
+
+// Queue the download of a BIN archive from resumeFrom on. When concurrency adapts, big archives are split into
+// segments, otherwise a few archives would leave the controller nothing to tune
+static void queue_BIN_archive_transfers(LolDLSession* session, Scheduler* scheduler, FileArchiveEntry* entry, unsigned int resumeFrom)
+{
+    if (!scheduler->controller.enabled || entry->size - resumeFrom <= 2 * SEGMENT_SIZE) {
+        scheduler_add(scheduler, TRANSFER_BIN_ARCHIVE, entry, entry->link, entry->fileName, entry->size, resumeFrom);
+        return;
+    }
+    // Segments are written in place, so the archive has to exist
+    char markerName[MAX_PATH + 16];
+    get_segments_marker_name(entry, markerName);
+    FILE* archive = fopen(entry->fileName, "ab");
+    FILE* marker = fopen(markerName, "wb");
+    if (archive) {
+        fclose(archive);
+    }
+    if (marker) {
+        fclose(marker);
+    }
+    int numSegments = 0;
+    for (unsigned int start = resumeFrom; start < entry->size; start += SEGMENT_SIZE) {
+        unsigned int size = entry->size - start < SEGMENT_SIZE ? entry->size - start : SEGMENT_SIZE;
+        Transfer* transfer = scheduler_add(scheduler, TRANSFER_BIN_RANGE, entry, entry->link, entry->fileName, size, 0);
+        if (!transfer) {
+            return;
+        }
+        transfer->hasRange = true;
+        transfer->rangeStart = start;
+        numSegments++;
+    }
+    session_print(session, "[INFO]: Downloading %s in %d segments\n", entry->fileName, numSegments);
+}
+
+// Cut BIN archives that were downloaded in segments back to the bytes that were received without gaps, so
+// the next run can resume them like any other archive
+static void finish_BIN_segments(LolDLSession* session, Scheduler* scheduler)
+{
+    for (ListNode* c = session->release->fileArchiveList.head; c; c = c->next) {
+        FileArchiveEntry* archive = c->fileArchiveEntry;
+        char markerName[MAX_PATH + 16];
+        get_segments_marker_name(archive, markerName);
+        if (!file_exists(markerName)) {
+            continue;
+        }
+        // Segments cover the archive without overlapping, so everything before the first gap is complete
+        unsigned int complete = archive->size;
+        for (int i = 0; i < scheduler->queueLength; i++) {
+            Transfer* transfer = &scheduler->queue[i];
+            if (transfer->type == TRANSFER_BIN_RANGE && !transfer->sink && transfer->fileArchiveEntry == archive && !transfer->done &&
+                transfer->rangeStart + transfer->bytesReceived < complete) {
+                complete = transfer->rangeStart + transfer->bytesReceived;
+            }
+        }
+        if (complete < archive->size && !truncate_file(archive->fileName, complete)) {
+            session_print(session, "[WARNING]: Couldn't truncate %s, removing it\n", archive->fileName);
+            remove(archive->fileName);
+        }
+        remove(markerName);
+    }
+}
+
+static void queue_BIN_archive(LolDLSession* session, Scheduler* scheduler, FileArchiveEntry* entry)
+{
+    char markerName[MAX_PATH + 16];
+    get_segments_marker_name(entry, markerName);
+    if (file_exists(markerName)) {
+        // An earlier run stopped before it could tell which parts of the archive were downloaded
+        session_print(session, "[WARNING]: %s was left with holes, downloading it again\n", entry->fileName);
+        remove(entry->fileName);
+        remove(markerName);
+    }
+    get_punched_marker_name(entry->fileName, markerName);
+    if (file_exists(markerName)) {
+        // An earlier run stopped while releasing space of the archive, the released regions read as zeros
+        session_print(session, "[WARNING]: %s had space released, downloading it again\n", entry->fileName);
+        remove(entry->fileName);
+        remove(markerName);
+    }
+    if (file_exists(entry->fileName)) {
+        if (session->options.removeExistingFiles) {
+            remove(entry->fileName);
+        } else {
+            FILE* archive = fopen(entry->fileName, "rb");
+            unsigned int localSize = file_size(archive);
+            fclose(archive);
+            unsigned int remoteSize = entry->size;
+            if (localSize < remoteSize) {
+                session_print(session, "[INFO]: Resuming download of %s\n", entry->fileName);
+                queue_BIN_archive_transfers(session, scheduler, entry, localSize);
+            } else if (localSize == remoteSize) {
+                session_print(session, "[INFO]: %s already exists, skipping download\n", entry->fileName);
+            } else {
+                session_print(session, "[WARNING]: Local %s is bigger than remote file\n", entry->fileName);
+            }
+            return;
+        }
+    } else  {
+        char dir[MAX_PATH];        
+        strcpy(dir, entry->fileName);
+        char* lastSlash = strrchr(dir, '/');
+        if (lastSlash) {
+            *lastSlash = '\0';
+            make_path(dir);
+        }
+    }
+    queue_BIN_archive_transfers(session, scheduler, entry, 0);
+}
+
+static void queue_individual_file(LolDLSession* session, Scheduler* scheduler, FileEntry* entry)
+{
+    char finalFileName[MAX_PATH]; // Final file name after decompressing
+    strcpy(finalFileName, entry->fileName);
+    char* lastDot = strrchr(finalFileName, '.');
+    if (lastDot) {
+        *lastDot = '\0';
+    }
+    
+    if (file_exists(finalFileName)) {
+        if (session->options.removeExistingFiles) {
+            remove(finalFileName);
+        } else {
+            return;
+        }
+    }
+    
+    if (file_exists(entry->fileName)) {
+        // Compressed file was already downloaded
+        inflate_individual_file(session, entry);
+        return;
+    }
+    
+    char dir[MAX_PATH];
+    strcpy(dir, entry->fileName);
+    char* lastSlash = strrchr(dir, '/');
+    if (lastSlash) {
+        *lastSlash = '\0';
+        make_path(dir);
+    }
+    scheduler_add(scheduler, TRANSFER_INDIVIDUAL_FILE, entry, entry->link, entry->fileName, entry->size, 0);
+}
+
+static bool add_file_entry(LolDLSession* session, FileEntry *entry)
+{
+    return list_add(&session->release->fileList, (void*)entry);
+}
+
+static bool add_file_archive_entry(LolDLSession* session, FileArchiveEntry* entry)
+{
+    return list_add(&session->release->fileArchiveList, (void*)entry);
+}
+
+// Allocate an entry of entrySize bytes with copies of link and fileName behind it, so freeing the entry frees them too.
+// Returns 0 if there isn't enough memory
+static void* new_entry_with_strings(size_t entrySize, const char* link, const char* fileName, char** linkCopy, char** fileNameCopy)
+{
+    size_t linkSize = strlen(link) + 1;
+    char* entry = malloc(entrySize + linkSize + strlen(fileName) + 1);
+    if (!entry) {
+        return 0;
+    }
+    *linkCopy = strcpy(entry + entrySize, link);
+    *fileNameCopy = strcpy(entry + entrySize + linkSize, fileName);
+    return entry;
+}
+
+// Strip the line break of a packagemanifest line. Returns false if the line didn't fit in the buffer
+static bool parse_packagemanifest_line_end(char* line, FILE* packagemanifest)
+{
+    char* lineEnd = strchr(line, '\n');
+    if (!lineEnd) {
+        return feof(packagemanifest);
+    }
+    if (lineEnd > line && lineEnd[-1] == '\r') {
+        lineEnd--;
+    }
+    *lineEnd = '\0';
+    return true;
+}
+
+// Parse a whole field as an unsigned number, returns false if it is empty, has anything else in it or doesn't fit
+static bool parse_unsigned_field(const char* field, int base, unsigned int* value)
+{
+    if (!isxdigit((unsigned char)field[0])) {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    unsigned long number = strtoul(field, &end, base);
+    if (*end != '\0' || errno == ERANGE || number > UINT_MAX) {
+        return false;
+    }
+    *value = (unsigned int)number;
+    return true;
+}
+
+// Returns false if packagemanifest is invalid. probedBINSizes is set to false if the size of a BIN archive
+// couldn't be probed, so it is left at 0 for this run and the file lists shouldn't be cached
+static bool parse_packagemanifest(LolDLSession* session, FILE* packagemanifest, bool* probedBINSizes)
+{
+    char line[MAX_LINE_LENGTH] = "";
+    if (!fgets(line, MAX_LINE_LENGTH, packagemanifest) || strcmp(line, "PKG1\r\n") != 0) {
+        session_print(session, "Invalid header: %s\n", line);
+        session_print(session, "BAD PACKAGEMANIFEST FILE!\n");
+        return false;
+    }
+    session->release->ownsEntries = true;
+    
+    int fileCount = 0;
+    int totalSize = 0;
+    int maxLineLength = 0;
+    bool hasBIN[MAX_BIN_COUNT] = {0};
+    
+    //printf("\nStart processing packagemanifest\n");
+    while (fgets(line, MAX_LINE_LENGTH, packagemanifest)) {
+        if (strlen(line) > maxLineLength) {
+            maxLineLength = strlen(line);
+        }
+        
+        // Fields are name,BIN_0xXXXXXXXX,offset in BIN,size,unknown
+        char* fields[5];
+        int numFields = 0;
+        char* field = line;
+        bool valid = parse_packagemanifest_line_end(line, packagemanifest);
+        while (valid && field && numFields < 5) {
+            fields[numFields++] = field;
+            field = strchr(field, ',');
+            if (field) {
+                *field++ = '\0';
+            }
+        }
+        
+        // Build file entry that will later be used to get the game file
+        FileEntry entry;
+        char link[MAX_URL_LENGTH];
+        char fileName[MAX_PATH];
+        unsigned int unk;
+        char* name = valid ? strstr(fields[0], "files/") : 0;
+        valid = valid && numFields == 5 && !field && name
+             && !strncmp(fields[1], "BIN_0x", 6) && parse_unsigned_field(fields[1] + 6, 16, &entry.BIN)
+             && entry.BIN < MAX_BIN_COUNT
+             && parse_unsigned_field(fields[2], 10, &entry.offsetInBIN)
+             && parse_unsigned_field(fields[3], 10, &entry.size)
+             && entry.size <= UINT_MAX - entry.offsetInBIN
+             && parse_unsigned_field(fields[4], 10, &unk);
+        name = valid ? strchr(name, '/') : 0;
+        valid = valid
+             && snprintf(fileName, MAX_PATH, "%s%s", session->release->destFolder, name) < MAX_PATH
+             && snprintf(link, MAX_URL_LENGTH, "%s%s%s", session->options.downloadURL, session->options.downloadPath, fields[0]) < MAX_URL_LENGTH;
+        if (!valid) {
+            session_print(session, "Invalid line %d\n", fileCount + 2);
+            session_print(session, "BAD PACKAGEMANIFEST FILE!\n");
+            return false;
+        }
+        hasBIN[entry.BIN] = true;
+        totalSize += entry.size;
+        entry.unk = (int)unk;
+        entry.index = fileCount;
+        
+        FileEntry* newEntry = new_entry_with_strings(sizeof(FileEntry), link, fileName, &entry.link, &entry.fileName);
+        if (!newEntry) {
+            set_out_of_memory(session);
+            return false;
+        }
+        *newEntry = entry;
+        if (!add_file_entry(session, newEntry)) {
+            free(newEntry);
+            set_out_of_memory(session);
+            return false;
+        }
+        
+        fileCount++;
+    }
+    
+    session->release->stats.numFilesInPackageManifest = fileCount;
+    session->release->stats.numBytesFromFileList = totalSize;
+    session->release->stats.maxLineLength = maxLineLength;
+    
+    char BINLink[MAX_URL_LENGTH] = {0};
+    char BINName[MAX_PATH] = {0};
+    unsigned int totalBINFilesSize = 0;
+    *probedBINSizes = true;
+    for (int i = 0; i < MAX_BIN_COUNT; i++) {
+        if (hasBIN[i]) {
+            session->release->stats.numBINArchives++;
+            sprintf(BINName, "BIN_0x%08x", i);
+            sprintf(BINLink, "%s%s%s%s%s%s", session->options.downloadURL, session->options.downloadPath, "/projects/lol_game_client/releases/", session->release->gameVersion, "/packages/files/", BINName);
+            //printf("BIN:\n  Link: %s\n  Name: %s\n", BINLink, BINName);
+            char BINFileName[MAX_PATH];
+            sprintf(BINFileName, "%s/%s", session->release->destFolder, BINName);
+            FileArchiveEntry archive;
+            FileArchiveEntry* entry = new_entry_with_strings(sizeof(FileArchiveEntry), BINLink, BINFileName, &archive.link, &archive.fileName);
+            if (!entry) {
+                set_out_of_memory(session);
+                return false;
+            }
+            if (!file_size_remote(session, BINLink, &archive.size)) {
+                session_print(session, "[WARNING]: Couldn't get the size of %s\n", BINLink);
+                archive.size = 0;
+                *probedBINSizes = false;
+            }
+            *entry = archive;
+            totalBINFilesSize += entry->size;
+            if (!add_file_archive_entry(session, entry)) {
+                free(entry);
+                set_out_of_memory(session);
+                return false;
+            }
+        }
+    }
+    
+    session->release->stats.numBytesFromBINArchives = totalBINFilesSize;
+    return true;
+}
+
+// Points at the string at offset in the index's string table, or returns 0 if it doesn't end within maxLength
+static char* get_index_string(char* strings, unsigned int stringTableSize, unsigned int offset, size_t maxLength)
+{
+    if (offset >= stringTableSize) {
+        return 0;
+    }
+    size_t remaining = stringTableSize - offset;
+    return memchr(strings + offset, '\0', remaining < maxLength ? remaining : maxLength) ? strings + offset : 0;
+}
+
+// Load file lists from the packagemanifest index if it was built from the same packagemanifest and options.
+// Strings are used in place from the mapped file, so no parsing (nor probing BIN sizes) is needed
+static bool load_packagemanifest_index(LolDLSession* session, char* indexPath, unsigned int packagemanifestSize, ManifestValidators* validators)
+{
+    Release* release = session->release;
+    if (!map_file(indexPath, &release->packagemanifestIndex)) {
+        return false;
+    }
+    
+    PackageManifestIndexHeader* header = (PackageManifestIndexHeader*)release->packagemanifestIndex.data;
+    bool valid = release->packagemanifestIndex.size >= sizeof(PackageManifestIndexHeader)
+              && header->magic == PACKAGEMANIFEST_INDEX_MAGIC
+              && header->version == PACKAGEMANIFEST_INDEX_VERSION
+              && header->sizeOfFileEntryRecord == sizeof(FileEntryRecord)
+              && header->sizeOfFileArchiveEntryRecord == sizeof(FileArchiveEntryRecord)
+              && header->packagemanifestSize == packagemanifestSize
+              && !strcmp(header->ETag, validators->ETag)
+              && !strcmp(header->downloadURL, session->options.downloadURL)
+              && !strcmp(header->downloadPath, session->options.downloadPath)
+              && !strcmp(header->gameVersion, release->gameVersion)
+              && !strcmp(header->destFolder, release->destFolder)
+              && header->stats.numFilesInPackageManifest >= 0
+              && header->stats.numBINArchives >= 0 && header->stats.numBINArchives <= MAX_BIN_COUNT
+              && release->packagemanifestIndex.size == sizeof(PackageManifestIndexHeader)
+                                                     + (size_t)header->stats.numFilesInPackageManifest * sizeof(FileEntryRecord)
+                                                     + (size_t)header->stats.numBINArchives * sizeof(FileArchiveEntryRecord)
+                                                     + header->stringTableSize;
+    FileEntryRecord* fileEntryRecords = (FileEntryRecord*)(header + 1);
+    FileArchiveEntryRecord* fileArchiveEntryRecords = valid ? (FileArchiveEntryRecord*)(fileEntryRecords + header->stats.numFilesInPackageManifest) : 0;
+    char* strings = valid ? (char*)(fileArchiveEntryRecords + header->stats.numBINArchives) : 0;
+    if (valid) {
+        release->indexFileEntries = malloc((header->stats.numFilesInPackageManifest + 1) * sizeof(FileEntry));
+        release->indexFileArchiveEntries = malloc((header->stats.numBINArchives + 1) * sizeof(FileArchiveEntry));
+        valid = release->indexFileEntries && release->indexFileArchiveEntries;
+    }
+    for (int i = 0; valid && i < header->stats.numFilesInPackageManifest; i++) {
+        FileEntryRecord* record = &fileEntryRecords[i];
+        release->indexFileEntries[i] = (FileEntry){.link        = get_index_string(strings, header->stringTableSize, record->link, MAX_URL_LENGTH),
+                                                   .fileName    = get_index_string(strings, header->stringTableSize, record->fileName, MAX_PATH),
+                                                   .BIN         = record->BIN,
+                                                   .offsetInBIN = record->offsetInBIN,
+                                                   .size        = record->size,
+                                                   .unk         = record->unk,
+                                                   .index       = i};
+        valid = release->indexFileEntries[i].link && release->indexFileEntries[i].fileName;
+    }
+    for (int i = 0; valid && i < header->stats.numBINArchives; i++) {
+        FileArchiveEntryRecord* record = &fileArchiveEntryRecords[i];
+        release->indexFileArchiveEntries[i] = (FileArchiveEntry){.link     = get_index_string(strings, header->stringTableSize, record->link, MAX_URL_LENGTH),
+                                                                 .fileName = get_index_string(strings, header->stringTableSize, record->fileName, MAX_PATH),
+                                                                 .size     = record->size};
+        valid = release->indexFileArchiveEntries[i].link && release->indexFileArchiveEntries[i].fileName;
+    }
+    if (!valid) {
+        free(release->indexFileEntries);
+        free(release->indexFileArchiveEntries);
+        release->indexFileEntries = 0;
+        release->indexFileArchiveEntries = 0;
+        unmap_file(&release->packagemanifestIndex);
+        return false;
+    }
+    
+    // The lists and arrays built so far are freed with the session
+    release->stats = header->stats;
+    for (int i = 0; i < release->stats.numFilesInPackageManifest; i++) {
+        if (!add_file_entry(session, &release->indexFileEntries[i])) {
+            set_out_of_memory(session);
+            return false;
+        }
+    }
+    for (int i = 0; i < release->stats.numBINArchives; i++) {
+        if (!add_file_archive_entry(session, &release->indexFileArchiveEntries[i])) {
+            set_out_of_memory(session);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Append a string to the index's string table
+static void write_index_string(FILE* index, const char* string, unsigned int* stringTableSize, bool* ok)
+{
+    size_t size = strlen(string) + 1;
+    *ok = *ok && fwrite(string, 1, size, index) == size;
+    *stringTableSize += size;
+}
+
+static void save_packagemanifest_index(LolDLSession* session, char* indexPath, unsigned int packagemanifestSize, ManifestValidators* validators)
+{
+    PackageManifestIndexHeader header = {.magic                        = PACKAGEMANIFEST_INDEX_MAGIC,
+                                         .version                      = PACKAGEMANIFEST_INDEX_VERSION,
+                                         .sizeOfFileEntryRecord        = sizeof(FileEntryRecord),
+                                         .sizeOfFileArchiveEntryRecord = sizeof(FileArchiveEntryRecord),
+                                         .packagemanifestSize          = packagemanifestSize,
+                                         .stats                        = session->release->stats};
+    strcpy(header.ETag, validators->ETag);
+    strcpy(header.downloadURL, session->options.downloadURL);
+    strcpy(header.downloadPath, session->options.downloadPath);
+    strcpy(header.gameVersion, session->release->gameVersion);
+    strcpy(header.destFolder, session->release->destFolder);
+    
+    // Write to a temporary file first so an interrupted run never leaves a truncated index behind
+    char tempPath[MAX_PATH];
+    sprintf(tempPath, "%.1000s.tmp", indexPath);
+    FILE* index = fopen(tempPath, "wb");
+    if (!index) {
+        session_print(session, "[WARNING]: Couldn't write to file: %s\n", tempPath);
+        return;
+    }
+    
+    // Records first, with string offsets counted in the same order the strings are written after them
+    bool ok = fseek(index, sizeof(header), SEEK_SET) == 0;
+    for (ListNode* c = session->release->fileList.head; c && ok; c = c->next) {
+        FileEntry* entry = c->fileEntry;
+        FileEntryRecord record = {.link        = header.stringTableSize,
+                                  .fileName    = header.stringTableSize + strlen(entry->link) + 1,
+                                  .BIN         = entry->BIN,
+                                  .offsetInBIN = entry->offsetInBIN,
+                                  .size        = entry->size,
+                                  .unk         = entry->unk};
+        header.stringTableSize = record.fileName + strlen(entry->fileName) + 1;
+        ok = fwrite(&record, sizeof(record), 1, index) == 1;
+    }
+    for (ListNode* c = session->release->fileArchiveList.head; c && ok; c = c->next) {
+        FileArchiveEntry* entry = c->fileArchiveEntry;
+        FileArchiveEntryRecord record = {.link     = header.stringTableSize,
+                                         .fileName = header.stringTableSize + strlen(entry->link) + 1,
+                                         .size     = entry->size};
+        header.stringTableSize = record.fileName + strlen(entry->fileName) + 1;
+        ok = fwrite(&record, sizeof(record), 1, index) == 1;
+    }
+    unsigned int stringTableSize = 0;
+    for (ListNode* c = session->release->fileList.head; c && ok; c = c->next) {
+        write_index_string(index, c->fileEntry->link, &stringTableSize, &ok);
+        write_index_string(index, c->fileEntry->fileName, &stringTableSize, &ok);
+    }
+    for (ListNode* c = session->release->fileArchiveList.head; c && ok; c = c->next) {
+        write_index_string(index, c->fileArchiveEntry->link, &stringTableSize, &ok);
+        write_index_string(index, c->fileArchiveEntry->fileName, &stringTableSize, &ok);
+    }
+    ok = ok && stringTableSize == header.stringTableSize
+            && fseek(index, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, index) == 1;
+    fclose(index);
+    
+    remove(indexPath);
+    if (!ok || rename(tempPath, indexPath) != 0) {
+        session_print(session, "[WARNING]: Couldn't write to file: %s\n", indexPath);
+        remove(tempPath);
+    }
+}
+
+// Load the digests recorded for the game files of this packagemanifest, or start with none if they were
+// recorded for a different one. Returns false if there isn't enough memory for them
+static bool load_digests(LolDLSession* session, char* digestsPath, unsigned int packagemanifestSize, ManifestValidators* validators)
+{
+    session->release->digests = calloc(session->release->stats.numFilesInPackageManifest + 1, sizeof(Digest));
+    if (!session->release->digests) {
+        set_out_of_memory(session);
+        return false;
+    }
+    FILE* file = fopen(digestsPath, "rb");
+    if (!file) {
+        return true;
+    }
+    DigestsHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+              && header.magic == DIGESTS_MAGIC
+              && header.version == DIGESTS_VERSION
+              && header.packagemanifestSize == packagemanifestSize
+              && !strncmp(header.ETag, validators->ETag, sizeof(header.ETag))
+              && header.numFiles == session->release->stats.numFilesInPackageManifest;
+    if (!valid || fread(session->release->digests, sizeof(Digest), header.numFiles, file) != header.numFiles) {
+        memset(session->release->digests, 0, session->release->stats.numFilesInPackageManifest * sizeof(Digest));
+    }
+    fclose(file);
+    return true;
+}
+
+static void save_digests(LolDLSession* session, char* digestsPath, unsigned int packagemanifestSize, ManifestValidators* validators)
+{
+    DigestsHeader header = {.magic                  = DIGESTS_MAGIC,
+                            .version                = DIGESTS_VERSION,
+                            .packagemanifestSize    = packagemanifestSize,
+                            .numFiles               = session->release->stats.numFilesInPackageManifest};
+    strcpy(header.ETag, validators->ETag);
+    
+    char tempPath[MAX_PATH];
+    sprintf(tempPath, "%.1000s.tmp", digestsPath);
+    FILE* file = fopen(tempPath, "wb");
+    if (!file) {
+        session_print(session, "[WARNING]: Couldn't write to file: %s\n", tempPath);
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(session->release->digests, sizeof(Digest), header.numFiles, file) == header.numFiles;
+    fclose(file);
+    
+    remove(digestsPath);
+    if (!ok || rename(tempPath, digestsPath) != 0) {
+        session_print(session, "[WARNING]: Couldn't write to file: %s\n", digestsPath);
+        remove(tempPath);
+    }
+}
+
+static void print_stats(LolDLSession* session)
+{
+    int totalSize = session->release->stats.numBytesFromFileList;
+    unsigned int totalBINFilesSize = session->release->stats.numBytesFromBINArchives;
+    if (totalBINFilesSize != totalSize) {
+        session_print(session, "[WARNING]: Total sizes don't match!");
+    }
+    
+    session_print(session, "\nStats:\n");
+    session_print(session, "  Total size (sum of individual files' sizes): %d B, %.2f KiB, %.2f MiB, %.2f GiB\n", totalSize, totalSize / 1024.0, totalSize / 1024.0 / 1024.0, totalSize / 1024.0 / 1024.0 / 1024.0);
+    session_print(session, "  Total size (sum of archive files' sizes):    %d B, %.2f KiB, %.2f MiB, %.2f GiB\n", totalBINFilesSize, totalBINFilesSize / 1024.0, totalBINFilesSize / 1024.0 / 1024.0, totalBINFilesSize / 1024.0 / 1024.0 / 1024.0);
+    session_print(session, "  Max line length: %d\n", session->release->stats.maxLineLength);
+    session_print(session, "  File count: %d\n", session->release->stats.numFilesInPackageManifest);
+    session_print(session, "  BIN file count: %d\n", session->release->stats.numBINArchives);
+    session_print(session, "\n");
+}
+
+// Allocate the buffer for the compressed bytes of entry. Returns false if there isn't enough memory
+static bool entry_feed_start(EntryFeed* feed, FileEntry* entry)
+{
+    feed->buffer = malloc(entry->size ? entry->size : 1);
+    feed->buffered = 0;
+    if (!feed->buffer) {
+        session_print(feed->session, "\n[ERROR]: Couldn't allocate memory to extract file: %s\n", entry->fileName);
+        set_error(feed->session, LOLDL_ERROR_OUT_OF_MEMORY);
+        return false;
+    }
+    return true;
+}
+
+static void entry_feed_free(EntryFeed* feed)
+{
+    free(feed->buffer);
+    free(feed->previous);
+    feed->buffer = 0;
+    feed->previous = 0;
+}
+
+// Receives the bytes of a BIN archive (or individual file) in order and emits every game file as soon as
+// all of its bytes arrived. Returns length, or 0 if the feed was stopped
+static size_t entry_feed(char* data, size_t length, void* sinkData)
+{
+    EntryFeed* feed = (EntryFeed*)sinkData;
+    LolDLSession* session = feed->session;
+    if (is_cancelled(session)) {
+        return 0;
+    }
+    size_t remaining = length;
+    while (feed->current < feed->numEntries) {
+        FileEntry* entry = feed->entries[feed->current];
+        if (!feed->buffer && feed->position > entry->offsetInBIN) {
+            // Shares bytes with the game file before it, which already arrived
+            if (!feed->previous || entry->offsetInBIN < feed->previousStart) {
+                // The stream goes on, but without this file it is incomplete
+                session_print(session, "\n[ERROR]: %s overlaps the previous file in its BIN, skipping it\n", entry->fileName);
+                set_error(session, LOLDL_ERROR_DOWNLOAD);
+                feed->current++;
+                continue;
+            }
+            if (!entry_feed_start(feed, entry)) {
+                return 0;
+            }
+            unsigned int end = entry->offsetInBIN + entry->size;
+            feed->buffered = (end < feed->position ? end : feed->position) - entry->offsetInBIN;
+            memcpy(feed->buffer, feed->previous + (entry->offsetInBIN - feed->previousStart), feed->buffered);
+        } else if (!remaining) {
+            break;
+        } else {
+            unsigned int chunk;
+            if (feed->position < entry->offsetInBIN) {
+                // Bytes between game files
+                chunk = entry->offsetInBIN - feed->position;
+                if (chunk > remaining) {
+                    chunk = remaining;
+                }
+            } else {
+                if (!feed->buffer) {
+                    // Game files after this one start at or after it, so none of them shares bytes with previous
+                    free(feed->previous);
+                    feed->previous = 0;
+                    if (!entry_feed_start(feed, entry)) {
+                        return 0;
+                    }
+                }
+                chunk = entry->size - feed->buffered;
+                if (chunk > remaining) {
+                    chunk = remaining;
+                }
+                memcpy(feed->buffer + feed->buffered, data, chunk);
+                feed->buffered += chunk;
+            }
+            data += chunk;
+            remaining -= chunk;
+            feed->position += chunk;
+        }
+        
+        if (feed->buffer && feed->buffered == entry->size) {
+            bool ok = feed->emit(session, entry, feed->buffer);
+            if (entry->offsetInBIN + entry->size == feed->position) {
+                free(feed->previous);
+                feed->previous = feed->buffer;
+                feed->previousStart = entry->offsetInBIN;
+            } else {
+                free(feed->buffer);
+            }
+            feed->buffer = 0;
+            feed->current++;
+            if (!ok) {
+                return 0;
+            }
+        }
+    }
+    if (feed->current == feed->numEntries) {
+        entry_feed_free(feed);
+    }
+    return length;
+}
+
+static void entry_feed_from_file(LolDLSession* session, EntryFeed* feed, char* fileName)
+{
+    FILE* file = fopen(fileName, "rb");
+    if (!file) {
+        session_print(session, "[ERROR]: Couldn't read file: %s\n", fileName);
+        return;
+    }
+    fseek(file, feed->position, SEEK_SET);
+    char buffer[CURL_MAX_WRITE_SIZE];
+    size_t length;
+    while (feed->current < feed->numEntries && (length = fread(buffer, 1, sizeof(buffer), file)) && entry_feed(buffer, length, feed)) {
+    }
+    fclose(file);
+}
+
+static int tar_write_callback(unsigned char* data, unsigned length, void* userdata)
+{
+    return fwrite(data, 1, length, (FILE*)userdata) == length;
+}
+
+static int count_callback(unsigned char* data, unsigned length, void* userdata)
+{
+    *(unsigned int*)userdata += length;
+    return 1;
+}
+
+static bool tar_write_padding(LolDLSession* session, unsigned int size)
+{
+    static char zeros[TAR_BLOCK_SIZE];
+    unsigned int padding = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+    return fwrite(zeros, 1, padding, session->options.tarOutput) == padding;
+}
+
+static bool tar_write_header(LolDLSession* session, char* name, unsigned int size, char typeflag)
+{
+    TarHeader header = {0};
+    size_t nameLength = strlen(name);
+    if (nameLength <= sizeof(header.name)) {
+        memcpy(header.name, name, nameLength);
+    } else {
+        // ustar splits long names at a slash into prefix and name
+        char* slash = strchr(name, '/');
+        while (slash && (nameLength - (slash - name) - 1 > sizeof(header.name))) {
+            slash = strchr(slash + 1, '/');
+        }
+        if (slash && slash - name <= sizeof(header.prefix)) {
+            memcpy(header.prefix, name, slash - name);
+            memcpy(header.name, slash + 1, nameLength - (slash - name) - 1);
+        } else {
+            // Too long even for ustar, use a GNU long name entry before the real one
+            if (!tar_write_header(session, "././@LongLink", nameLength + 1, 'L')
+                || fwrite(name, 1, nameLength + 1, session->options.tarOutput) != nameLength + 1
+                || !tar_write_padding(session, nameLength + 1)) {
+                return false;
+            }
+            memcpy(header.name, name, sizeof(header.name));
+        }
+    }
+    sprintf(header.mode, "%07o", 0644);
+    sprintf(header.uid, "%07o", 0);
+    sprintf(header.gid, "%07o", 0);
+    sprintf(header.size, "%011o", size);
+    sprintf(header.mtime, "%011lo", (unsigned long)time(0));
+    header.typeflag = typeflag;
+    memcpy(header.magic, "ustar", 6);
+    memcpy(header.version, "00", 2);
+    
+    memset(header.checksum, ' ', sizeof(header.checksum));
+    unsigned int checksum = 0;
+    for (int i = 0; i < sizeof(header); i++) {
+        checksum += ((unsigned char*)&header)[i];
+    }
+    sprintf(header.checksum, "%06o", checksum);
+    header.checksum[7] = ' ';
+    
+    return fwrite(&header, sizeof(header), 1, session->options.tarOutput) == 1;
+}
+
+// Inflate a game file and write it to the tar stream. It is inflated twice, the first time only to get
+// its size for the header, so nothing but its compressed bytes has to be kept in memory
+static bool tar_write_entry(LolDLSession* session, FileEntry* entry, unsigned char* data)
+{
+    // Name relative to destFolder, without the extension of the compressed file
+    char name[MAX_PATH];
+    char* relativeName = entry->fileName + strlen(session->release->destFolder);
+    while (*relativeName == '/') {
+        relativeName++;
+    }
+    strcpy(name, relativeName);
+    char* lastDot = strrchr(name, '.');
+    if (lastDot) {
+        *lastDot = '\0';
+    }
+    
+    unsigned int size = 0;
+    if (inf_buffer(data, entry->size, count_callback, &size) != 0) {
+        // Skip it, the stream is still fine but incomplete
+        session_print(session, "\n[ERROR]: Couldn't decompress file: %s\n", name);
+        set_error(session, LOLDL_ERROR_DOWNLOAD);
+        return true;
+    }
+    if (!tar_write_header(session, name, size, '0')
+        || inf_buffer(data, entry->size, tar_write_callback, session->options.tarOutput) != 0
+        || !tar_write_padding(session, size)) {
+        session_print(session, "\n[ERROR]: Couldn't write to the tar stream\n");
+        set_error(session, LOLDL_ERROR_WRITE);
+        return false;
+    }
+    return true;
+}
+
+static FileArchiveEntry* find_BIN_archive(LolDLSession* session, unsigned int BIN)
+{
+    char BINFileName[MAX_PATH];
+    sprintf(BINFileName, "%s/BIN_0x%08x", session->release->destFolder, BIN);
+    for (ListNode* c = session->release->fileArchiveList.head; c; c = c->next) {
+        if (!strcmp(c->fileArchiveEntry->fileName, BINFileName)) {
+            return c->fileArchiveEntry;
+        }
+    }
+    return 0;
+}
+
+static bool is_BIN_archive_complete(FileArchiveEntry* archive)
+{
+    char markerName[MAX_PATH + 16];
+    get_segments_marker_name(archive, markerName);
+    if (file_exists(markerName)) {
+        return false;
+    }
+    get_punched_marker_name(archive->fileName, markerName);
+    if (file_exists(markerName)) {
+        return false;
+    }
+    FILE* archiveFile = fopen(archive->fileName, "rb");
+    if (!archiveFile) {
+        return false;
+    }
+    bool complete = file_size(archiveFile) == archive->size;
+    fclose(archiveFile);
+    return complete;
+}
+
+// Write all game files to the tar stream without storing anything in destFolder. BIN archives that
+// are already complete on disk are read from there, everything else is streamed from the network
+static void stream_game_files(LolDLSession* session)
+{
+    FileEntry** entries = malloc((session->release->stats.numFilesInPackageManifest + 1) * sizeof(FileEntry*));
+    EntryFeed* feeds = calloc(session->release->stats.numFilesInPackageManifest + 1, sizeof(EntryFeed));
+    if (!entries || !feeds) {
+        set_out_of_memory(session);
+        free(entries);
+        free(feeds);
+        return;
+    }
+    int numEntries = 0;
+    for (ListNode* c = session->release->fileList.head; c; c = c->next) {
+        entries[numEntries++] = c->fileEntry;
+    }
+    
+    // A single transfer at a time, so game files reach the stream in order
+    Scheduler scheduler;
+    set_stage(session, LOLDL_STAGE_DOWNLOADING);
+    scheduler_init(&scheduler, session, 1, 0, atomic_load(&session->rateLimit), find_scheduling_policy("manifest"));
+    int numFeeds = 0;
+    if (session->options.useBINFiles) {
+        qsort(entries, numEntries, sizeof(FileEntry*), compare_BIN_offset);
+        int first = 0;
+        while (first < numEntries) {
+            int last = first;
+            while (last < numEntries && entries[last]->BIN == entries[first]->BIN) {
+                last++;
+            }
+            EntryFeed* feed = &feeds[numFeeds++];
+            *feed = (EntryFeed){.entries = &entries[first], .numEntries = last - first, .emit = tar_write_entry, .session = session};
+            
+            FileArchiveEntry* archive = find_BIN_archive(session, entries[first]->BIN);
+            if (archive && is_BIN_archive_complete(archive)) {
+                session_print(session, "Streaming: %s (from disk)\n", archive->fileName);
+                entry_feed_from_file(session, feed, archive->fileName);
+            } else if (archive) {
+                Transfer* transfer = scheduler_add(&scheduler, TRANSFER_BIN_ARCHIVE, archive, archive->link, archive->fileName, archive->size, 0);
+                if (!transfer) {
+                    break;
+                }
+                transfer->sink = entry_feed;
+                transfer->sinkData = feed;
+            }
+            first = last;
+        }
+    } else {
+        for (int i = 0; i < numEntries; i++) {
+            EntryFeed* feed = &feeds[numFeeds++];
+            *feed = (EntryFeed){.entries = &entries[i], .numEntries = 1, .position = entries[i]->offsetInBIN, .emit = tar_write_entry, .session = session};
+            Transfer* transfer = scheduler_add(&scheduler, TRANSFER_INDIVIDUAL_FILE, entries[i], entries[i]->link, entries[i]->fileName, entries[i]->size, 0);
+            if (!transfer) {
+                break;
+            }
+            transfer->sink = entry_feed;
+            transfer->sinkData = feed;
+        }
+    }
+    scheduler_run(&scheduler);
+    scheduler_cleanup(&scheduler);
+    
+    // End of archive, left out when cancelled so the stream is seen as incomplete
+    static char zeros[2 * TAR_BLOCK_SIZE];
+    if (!is_cancelled(session) && (fwrite(zeros, 1, sizeof(zeros), session->options.tarOutput) != sizeof(zeros) || fflush(session->options.tarOutput) != 0)) {
+        session_print(session, "\n[ERROR]: Couldn't write to the tar stream\n");
+        set_error(session, LOLDL_ERROR_WRITE);
+    }
+    
+    for (int i = 0; i < numFeeds; i++) {
+        entry_feed_free(&feeds[i]);
+    }
+    free(feeds);
+    free(entries);
+}
+
+static void verify_worker(void* data)
+{
+    VerifyJob* job = (VerifyJob*)data;
+    LolDLSession* session = job->session;
+    int i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->numEntries && !is_cancelled(session)) {
+        FileEntry* entry = job->entries[i];
+        char finalFileName[MAX_PATH];
+        get_final_file_name(entry, finalFileName);
+        Digest* digest = &session->release->digests[entry->index];
+        if (digest->valid) {
+            unsigned long long hash;
+            unsigned int size;
+            job->damaged[i] = !hash_file(finalFileName, &hash, &size) || size != digest->size || hash != digest->hash;
+        } else {
+            // Nothing was recorded to compare with, only its presence can be checked
+            job->damaged[i] = !file_exists(finalFileName);
+        }
+        publish_file_progress(session, job->numEntries, atomic_fetch_add(&job->numVerified, 1) + 1);
+    }
+}
+
+// Queue the download of some game files of the release being worked on, each feed (at most one per game file)
+// passes them to emit. From BIN archives, game files close to each other are fetched with one range request,
+// and the ones in archives that are already complete on disk are read from there right away
+static void queue_game_files(LolDLSession* session, Scheduler* scheduler, FileEntry** entries, int numEntries, EntryFeed* feeds, int* numFeeds,
+                             bool (*emit)(LolDLSession* session, FileEntry* entry, unsigned char* data))
+{
+    if (session->options.useBINFiles) {
+        qsort(entries, numEntries, sizeof(FileEntry*), compare_BIN_offset);
+        int first = 0;
+        while (first < numEntries) {
+            FileArchiveEntry* archive = find_BIN_archive(session, entries[first]->BIN);
+            int end = first;
+            while (end < numEntries && entries[end]->BIN == entries[first]->BIN) {
+                end++;
+            }
+            if (!archive) {
+                first = end;
+                continue;
+            }
+            
+            // Coalesce game files that are close to each other into one range request, or one read of the archive
+            // if it is complete on disk. Game files that share bytes with the previous one start a new range
+            bool fromDisk = is_BIN_archive_complete(archive);
+            while (first < end) {
+                unsigned int rangeStart = entries[first]->offsetInBIN;
+                unsigned int rangeEnd = rangeStart + entries[first]->size;
+                int last = first + 1;
+                while (last < end) {
+                    unsigned int nextEnd = entries[last]->offsetInBIN + entries[last]->size;
+                    if (entries[last]->offsetInBIN < rangeEnd || entries[last]->offsetInBIN - rangeEnd > COALESCE_MAX_GAP || nextEnd - rangeStart > COALESCE_MAX_RANGE) {
+                        break;
+                    }
+                    rangeEnd = nextEnd;
+                    last++;
+                }
+                EntryFeed* feed = &feeds[(*numFeeds)++];
+                *feed = (EntryFeed){.entries = &entries[first], .numEntries = last - first, .position = rangeStart, .emit = emit, .session = session};
+                if (fromDisk) {
+                    entry_feed_from_file(session, feed, archive->fileName);
+                } else {
+                    Transfer* transfer = scheduler_add(scheduler, TRANSFER_BIN_RANGE, archive, archive->link, archive->fileName, rangeEnd - rangeStart, 0);
+                    if (!transfer) {
+                        return;
+                    }
+                    transfer->sink = entry_feed;
+                    transfer->sinkData = feed;
+                    transfer->hasRange = true;
+                    transfer->rangeStart = rangeStart;
+                }
+                first = last;
+            }
+        }
+    } else {
+        for (int i = 0; i < numEntries; i++) {
+            EntryFeed* feed = &feeds[(*numFeeds)++];
+            *feed = (EntryFeed){.entries = &entries[i], .numEntries = 1, .position = entries[i]->offsetInBIN, .emit = emit, .session = session};
+            Transfer* transfer = scheduler_add(scheduler, TRANSFER_INDIVIDUAL_FILE, entries[i], entries[i]->link, entries[i]->fileName, entries[i]->size, 0);
+            if (!transfer) {
+                return;
+            }
+            transfer->sink = entry_feed;
+            transfer->sinkData = feed;
+        }
+    }
+}
+
+// Hash existing game files in parallel, compare them with the recorded digests and download only the
+// ones that are missing or damaged. From BIN archives, nearby game files are fetched with one range request
+static void verify_and_repair_game_files(LolDLSession* session)
+{
+    FileEntry** entries = malloc((session->release->stats.numFilesInPackageManifest + 1) * sizeof(FileEntry*));
+    bool* damaged = calloc(session->release->stats.numFilesInPackageManifest + 1, sizeof(bool));
+    if (!entries || !damaged) {
+        set_out_of_memory(session);
+        free(entries);
+        free(damaged);
+        return;
+    }
+    int numEntries = 0;
+    int numUnverifiable = 0;
+    for (ListNode* c = session->release->fileList.head; c; c = c->next) {
+        entries[numEntries++] = c->fileEntry;
+        if (!session->release->digests[c->fileEntry->index].valid) {
+            numUnverifiable++;
+        }
+    }
+    
+    set_stage(session, LOLDL_STAGE_VERIFYING);
+    int numThreads = get_cpu_count();
+    session_print(session, "Verifying %d game files using %d threads...\n", numEntries, numThreads);
+    VerifyJob job = {.entries = entries, .numEntries = numEntries, .damaged = damaged, .session = session};
+    atomic_init(&job.next, 0);
+    atomic_init(&job.numVerified, 0);
+    run_in_parallel(verify_worker, &job, numThreads);
+    if (is_cancelled(session)) {
+        set_error(session, LOLDL_ERROR_CANCELLED);
+        free(damaged);
+        free(entries);
+        return;
+    }
+    
+    int numDamaged = 0;
+    for (int i = 0; i < numEntries; i++) {
+        if (damaged[i]) {
+            entries[numDamaged++] = entries[i];
+        }
+    }
+    free(damaged);
+    if (numUnverifiable) {
+        session_print(session, "[WARNING]: No digests recorded for %d game files, only checked that they exist\n", numUnverifiable);
+    }
+    session_print(session, "[INFO]: %d game files missing or damaged\n", numDamaged);
+    if (!numDamaged) {
+        free(entries);
+        return;
+    }
+    
+    session_print(session, "Repairing game files...\n");
+    set_stage(session, LOLDL_STAGE_DOWNLOADING);
+    EntryFeed* feeds = calloc(numDamaged, sizeof(EntryFeed));
+    if (!feeds) {
+        set_out_of_memory(session);
+        free(entries);
+        return;
+    }
+    Scheduler scheduler;
+    scheduler_init(&scheduler, session, session->options.maxTransfers, session->options.maxAdaptiveTransfers, atomic_load(&session->rateLimit), session->schedulingPolicy);
+    int numFeeds = 0;
+    queue_game_files(session, &scheduler, entries, numDamaged, feeds, &numFeeds, write_game_file);
+    session_print(session, "[INFO]: Fetching %d game files with %d requests\n", numDamaged, scheduler.queueLength);
+    scheduler_run(&scheduler);
+    scheduler_cleanup(&scheduler);
+    
+    for (int i = 0; i < numFeeds; i++) {
+        entry_feed_free(&feeds[i]);
+    }
+    free(feeds);
+    free(entries);
+}
+
+static void download_game_files(LolDLSession* session)
+{
+    ListNode* c;
+    int i;
+    if (session->options.tarStream) {
+        stream_game_files(session);
+        return;
+    }
+    
+    set_stage(session, LOLDL_STAGE_DOWNLOADING);
+    scheduler_init(&session->scheduler, session, session->options.maxTransfers, session->options.maxAdaptiveTransfers, atomic_load(&session->rateLimit), session->schedulingPolicy);
+    if (session->options.useBINFiles) {
+        session_print(session, "\nDownloading BIN files...\n");
+        for (c = session->release->fileArchiveList.head; c; c = c->next) {
+            queue_BIN_archive(session, &session->scheduler, c->fileArchiveEntry);
+        }
+    } else {
+        session_print(session, "Downloading game files...\n");
+        for (c = session->release->fileList.head; c; c = c->next) {
+            queue_individual_file(session, &session->scheduler, c->fileEntry);
+        }
+    }
+    scheduler_run(&session->scheduler);
+    bool outOfMemory = session->scheduler.outOfMemory;
+    if (session->options.useBINFiles && !outOfMemory) {
+        finish_BIN_segments(session, &session->scheduler);
+    }
+    scheduler_cleanup(&session->scheduler);
+    if (!session->options.useBINFiles || outOfMemory || is_cancelled(session)) {
+        return;
+    }
+    
+    session_print(session, "Extracting game files...\n");
+    set_stage(session, LOLDL_STAGE_EXTRACTING);
+    if (session->options.punchHoles && !session->options.keepBINFiles) {
+        extract_from_BIN_files_releasing_space(session);
+        return;
+    }
+    for (i = 1, c = session->release->fileList.head; c; c = c->next, i++) {
+        print_extraction_progress(session, i);
+        if (is_cancelled(session)) {
+            set_error(session, LOLDL_ERROR_CANCELLED);
+            return;
+        }
+        if (!extract_from_BIN(session, c->fileEntry)) {
+            return;
+        }
+    }
+    
+    // Remove BIN files
+    if (!session->options.keepBINFiles) {
+        for (i = 1, c = session->release->fileArchiveList.head; c; c = c->next, i++) {
+            FileArchiveEntry* entry = c->fileArchiveEntry;
+            remove(entry->fileName);
+        }
+    }
+}
+
+// Orders game files by content identity, missing ones first, then by release
+static int compare_content_identity(const void* a, const void* b)
+{
+    const GameFileCopy* c1 = (const GameFileCopy*)a;
+    const GameFileCopy* c2 = (const GameFileCopy*)b;
+    int ret = strcmp(c1->entry->link, c2->entry->link);
+    if (ret) {
+        return ret;
+    }
+    if (c1->entry->size != c2->entry->size) {
+        return c1->entry->size < c2->entry->size ? -1 : 1;
+    }
+    if (c1->exists != c2->exists) {
+        return c1->exists ? 1 : -1;
+    }
+    return (c1->release > c2->release) - (c1->release < c2->release);
+}
+
+static int compare_shared_game_file_entry(const void* a, const void* b)
+{
+    const FileEntry* e1 = ((const SharedGameFile*)a)->copies[0].entry;
+    const FileEntry* e2 = ((const SharedGameFile*)b)->copies[0].entry;
+    return (e1 > e2) - (e1 < e2);
+}
+
+// Emits a game file that was downloaded for several releases: it is inflated once and copied to the others
+static bool write_shared_game_file(LolDLSession* session, FileEntry* entry, unsigned char* data)
+{
+    GameFileCopy copy = {.entry = entry};
+    SharedGameFile key = {.copies = &copy};
+    SharedGameFile* shared = bsearch(&key, session->sharedGameFiles, session->numSharedGameFiles, sizeof(SharedGameFile), compare_shared_game_file_entry);
+    assert(shared);
+    if (inflate_game_file(session, shared->copies[0].release, entry, data, entry->size)) {
+        for (int i = 1; i < shared->numCopies; i++) {
+            copy_game_file(session, &shared->copies[0], &shared->copies[i]);
+        }
+    }
+    return true;
+}
+
+// Download the game files of all releases of the session together. Game files with the same content identity are
+// downloaded once and written to every release that has them, or copied from a release that already has them.
+// All downloads run in one scheduler, so they share its pool of connections
+static void download_releases(LolDLSession* session)
+{
+    set_stage(session, LOLDL_STAGE_DOWNLOADING);
+    session_print(session, "\nDownloading game files of %d game versions...\n", session->numReleases);
+    int numCopies = 0;
+    for (int i = 0; i < session->numReleases; i++) {
+        numCopies += session->releases[i].stats.numFilesInPackageManifest;
+    }
+    GameFileCopy* copies = malloc((numCopies ? numCopies : 1) * sizeof(GameFileCopy));
+    SharedGameFile* sharedGameFiles = malloc((numCopies ? numCopies : 1) * sizeof(SharedGameFile));
+    if (!copies || !sharedGameFiles) {
+        set_out_of_memory(session);
+        free(copies);
+        free(sharedGameFiles);
+        return;
+    }
+    numCopies = 0;
+    for (int i = 0; i < session->numReleases; i++) {
+        for (ListNode* c = session->releases[i].fileList.head; c; c = c->next) {
+            char finalFileName[MAX_PATH];
+            get_final_file_name(c->fileEntry, finalFileName);
+            GameFileCopy* copy = &copies[numCopies++];
+            *copy = (GameFileCopy){.entry = c->fileEntry, .release = &session->releases[i], .exists = file_exists(finalFileName)};
+            if (copy->exists && session->options.removeExistingFiles) {
+                remove(finalFileName);
+                copy->exists = false;
+            }
+        }
+    }
+    
+    // Missing game files that another release already has are copied, the others are downloaded once per content identity
+    qsort(copies, numCopies, sizeof(GameFileCopy), compare_content_identity);
+    int numShared = 0;
+    int numCopied = 0;
+    int numMissing = 0;
+    unsigned int bytesMissing = 0;
+    unsigned int bytesShared = 0;
+    int first = 0;
+    while (first < numCopies && !is_cancelled(session)) {
+        int end = first + 1;
+        while (end < numCopies && !strcmp(copies[end].entry->link, copies[first].entry->link) && copies[end].entry->size == copies[first].entry->size) {
+            end++;
+        }
+        int firstExisting = first;
+        while (firstExisting < end && !copies[firstExisting].exists) {
+            firstExisting++;
+        }
+        numMissing += firstExisting - first;
+        bytesMissing += (firstExisting - first) * copies[first].entry->size;
+        if (firstExisting > first && firstExisting < end) {
+            for (int i = first; i < firstExisting; i++) {
+                copy_game_file(session, &copies[firstExisting], &copies[i]);
+            }
+            numCopied += firstExisting - first;
+        } else if (firstExisting > first) {
+            sharedGameFiles[numShared++] = (SharedGameFile){.copies = &copies[first], .numCopies = firstExisting - first};
+            bytesShared += copies[first].entry->size;
+        }
+        first = end;
+    }
+    char missing[64];
+    char shared[64];
+    build_size_string(missing, bytesMissing);
+    build_size_string(shared, bytesShared);
+    session_print(session, "[INFO]: %d game files missing (%s), %d copied from other game versions, %d to download once (%s)\n",
+                  numMissing, missing, numCopied, numShared, shared);
+    
+    // Queue the downloads from the release of each game file's first copy
+    FileEntry** entries = malloc((numShared ? numShared : 1) * sizeof(FileEntry*));
+    EntryFeed* feeds = calloc(numShared ? numShared : 1, sizeof(EntryFeed));
+    if (!entries || !feeds) {
+        set_out_of_memory(session);
+        free(entries);
+        free(feeds);
+        free(sharedGameFiles);
+        free(copies);
+        return;
+    }
+    qsort(sharedGameFiles, numShared, sizeof(SharedGameFile), compare_shared_game_file_entry);
+    session->sharedGameFiles = sharedGameFiles;
+    session->numSharedGameFiles = numShared;
+    int numEntries = 0;
+    int numFeeds = 0;
+    scheduler_init(&session->scheduler, session, session->options.maxTransfers, session->options.maxAdaptiveTransfers, atomic_load(&session->rateLimit), session->schedulingPolicy);
+    for (int i = 0; i < session->numReleases && !is_cancelled(session); i++) {
+        session->release = &session->releases[i];
+        int firstEntry = numEntries;
+        for (int j = 0; j < numShared; j++) {
+            if (sharedGameFiles[j].copies[0].release == session->release) {
+                entries[numEntries++] = sharedGameFiles[j].copies[0].entry;
+            }
+        }
+        queue_game_files(session, &session->scheduler, &entries[firstEntry], numEntries - firstEntry, feeds, &numFeeds, write_shared_game_file);
+    }
+    session_print(session, "[INFO]: Fetching %d game files with %d requests\n", numShared, session->scheduler.queueLength);
+    scheduler_run(&session->scheduler);
+    scheduler_cleanup(&session->scheduler);
+    
+    session->sharedGameFiles = 0;
+    session->numSharedGameFiles = 0;
+    for (int i = 0; i < numFeeds; i++) {
+        entry_feed_free(&feeds[i]);
+    }
+    free(feeds);
+    free(entries);
+    free(sharedGameFiles);
+    free(copies);
+}
+
+// The index and the digests were built from the packagemanifest that was just replaced. Their headers can't
+// always tell, e.g. a new packagemanifest of the same size from a server that only sends Last-Modified
+static void remove_packagemanifest_caches(char* indexPath, char* digestsPath)
+{
+    remove(indexPath);
+    remove(digestsPath);
+}
+
+// Download (or validate) the packagemanifest of the release being worked on and get its game file lists
+static LolDLResult load_release(LolDLSession* session)
+{
+    CURLcode ret = CURLE_OK;
+    
+    // Download packagemanifest
+    char packagemanifestURL[MAX_URL_LENGTH];
+    char packagemanifestPath[MAX_PATH];
+    char validatorsPath[MAX_PATH];
+    char indexPath[MAX_PATH];
+    char* digestsPath = session->release->digestsPath;
+    FILE* packagemanifest;
+    strcpy(packagemanifestURL, session->options.downloadURL);
+    strcat(packagemanifestURL, session->options.downloadPath);
+    strcat(packagemanifestURL, "/projects/lol_game_client/releases/");
+    strcat(packagemanifestURL, session->release->gameVersion);
+    strcat(packagemanifestURL, "/packages/files/packagemanifest");
+    strcpy(packagemanifestPath, session->release->destFolder);
+    strcat(packagemanifestPath, "/");
+    make_path(packagemanifestPath);
+    strcat(packagemanifestPath, "packagemanifest");
+    strcpy(validatorsPath, packagemanifestPath);
+    strcat(validatorsPath, ".etag");
+    strcpy(indexPath, packagemanifestPath);
+    strcat(indexPath, ".idx");
+    strcpy(digestsPath, packagemanifestPath);
+    strcat(digestsPath, ".digests");
+    
+    ManifestValidators validators;
+    bool hasValidators = read_packagemanifest_validators(validatorsPath, &validators);
+    if (!file_exists(packagemanifestPath)) {
+        session_print(session, "[INFO]: packagemanifest not found, downloading it...\n");
+        validators = (ManifestValidators){0};
+        packagemanifest = fopen(packagemanifestPath, "wb");
+        if (!packagemanifest) {
+            session_print(session, "[ERROR]: Couldn't write to file: %s\n", packagemanifestPath);
+            return LOLDL_ERROR_WRITE;
+        }
+        curl_easy_setopt(session->curl, CURLOPT_WRITEDATA, (void*)packagemanifest);
+        curl_easy_setopt(session->curl, CURLOPT_URL, packagemanifestURL);
+        curl_easy_setopt(session->curl, CURLOPT_HEADERFUNCTION, validators_header_callback);
+        curl_easy_setopt(session->curl, CURLOPT_HEADERDATA, (void*)&validators);
+        curl_easy_setopt(session->curl, CURLOPT_FAILONERROR, 1L); // An error page isn't a packagemanifest
+        session->progressData = (ProgressData){0};
+        ret = curl_easy_perform(session->curl);
+        fclose(packagemanifest);
+        // Restore defaults
+        curl_easy_setopt(session->curl, CURLOPT_HEADERFUNCTION, (void*)0);
+        curl_easy_setopt(session->curl, CURLOPT_HEADERDATA, (void*)0);
+        curl_easy_setopt(session->curl, CURLOPT_FAILONERROR, 0L);
+        if (ret != CURLE_OK) {
+            // Don't leave a partial packagemanifest (or an error page) behind, it would be seen as complete on the next run
+            remove(packagemanifestPath);
+        } else {
+            write_packagemanifest_validators(session, validatorsPath, &validators);
+            remove_packagemanifest_caches(indexPath, digestsPath);
+        }
+    } else if (hasValidators) {
+        // A single conditional request replaces probing the size and then downloading
+        long responseCode = download_packagemanifest_if_modified(session, packagemanifestURL, packagemanifestPath, &validators);
+        if (responseCode == 304) {
+            session_print(session, "[INFO]: packagemanifest not modified, skipping download\n");
+        } else if (responseCode == 200) {
+            session_print(session, "\n[INFO]: packagemanifest changed, downloaded new version\n");
+            write_packagemanifest_validators(session, validatorsPath, &validators);
+            remove_packagemanifest_caches(indexPath, digestsPath);
+        } else {
+            session_print(session, "[WARNING]: Couldn't validate packagemanifest (response code %ld), using local copy\n", responseCode);
+        }
+    } else {
+        packagemanifest = fopen(packagemanifestPath, "rb");
+        unsigned int localSize = file_size(packagemanifest);
+        fclose(packagemanifest);
+        // Installs from before validators were stored get them from this probe, so later runs can make conditional requests
+        unsigned int remoteSize;
+        if (!probe_remote_file(session, packagemanifestURL, validators_header_callback, &validators, &remoteSize)) {
+            session_print(session, "[WARNING]: Couldn't get the size of packagemanifest, using local copy\n");
+        } else if (localSize < remoteSize) {
+            session_print(session, "[INFO]: Resuming download of packagemanifest\n");
+            packagemanifest = fopen(packagemanifestPath, "ab");
+            if (!packagemanifest) {
+                session_print(session, "[ERROR]: Couldn't write to file: %s\n", packagemanifestPath);
+                return LOLDL_ERROR_WRITE;
+            }
+            curl_easy_setopt(session->curl, CURLOPT_RESUME_FROM, localSize);
+            curl_easy_setopt(session->curl, CURLOPT_WRITEDATA, (void*)packagemanifest);
+            curl_easy_setopt(session->curl, CURLOPT_URL, packagemanifestURL);
+            curl_easy_setopt(session->curl, CURLOPT_HEADERFUNCTION, validators_header_callback);
+            curl_easy_setopt(session->curl, CURLOPT_HEADERDATA, (void*)&validators);
+            curl_easy_setopt(session->curl, CURLOPT_FAILONERROR, 1L);
+            session->progressData = (ProgressData){0};
+            session->progressData.bytesAlreadyDownloaded = localSize;
+            ret = curl_easy_perform(session->curl);
+            fclose(packagemanifest);
+            // Restore defaults
+            curl_easy_setopt(session->curl, CURLOPT_RESUME_FROM, 0L);
+            curl_easy_setopt(session->curl, CURLOPT_HEADERFUNCTION, (void*)0);
+            curl_easy_setopt(session->curl, CURLOPT_HEADERDATA, (void*)0);
+            curl_easy_setopt(session->curl, CURLOPT_FAILONERROR, 0L);
+            if (ret == CURLE_OK) {
+                write_packagemanifest_validators(session, validatorsPath, &validators);
+                remove_packagemanifest_caches(indexPath, digestsPath);
+            } else if (ret == CURLE_HTTP_RETURNED_ERROR) {
+                // The server won't complete this copy, the next run starts over
+                remove(packagemanifestPath);
+            }
+        } else if (localSize == remoteSize) {
+            session_print(session, "[INFO]: packagemanifest already exists, skipping download\n");
+            write_packagemanifest_validators(session, validatorsPath, &validators);
+        } else {
+            session_print(session, "[WARNING]: Local packagemanifest is bigger than remote packagemanifest\n");
+        }
+    }
+    if (is_cancelled(session)) {
+        return LOLDL_ERROR_CANCELLED;
+    }
+    if (ret != CURLE_OK) {
+        session_print(session, "\n[ERROR]: Couldn't download packagemanifest: %s\n", curl_easy_strerror(ret));
+        return LOLDL_ERROR_PACKAGEMANIFEST;
+    }
+    
+    // Get game file lists, from the cached index if it's still valid for this packagemanifest
+    packagemanifest = fopen(packagemanifestPath, "rb");
+    if (!packagemanifest) {
+        session_print(session, "[ERROR]: Couldn't read file: %s\n", packagemanifestPath);
+        return LOLDL_ERROR_PACKAGEMANIFEST;
+    }
+    unsigned int packagemanifestSize = file_size(packagemanifest);
+    bool probedBINSizes;
+    if (load_packagemanifest_index(session, indexPath, packagemanifestSize, &validators)) {
+        session_print(session, "[INFO]: Using cached packagemanifest index\n");
+    } else if (session->error == LOLDL_OK && parse_packagemanifest(session, packagemanifest, &probedBINSizes)) {
+        if (probedBINSizes) {
+            save_packagemanifest_index(session, indexPath, packagemanifestSize, &validators);
+        } else {
+            // Don't keep an index built with unknown sizes, they are probed again on the next run
+            remove(indexPath);
+        }
+    } else {
+        fclose(packagemanifest);
+        return session->error != LOLDL_OK ? session->error : LOLDL_ERROR_PACKAGEMANIFEST;
+    }
+    fclose(packagemanifest);
+    print_stats(session);
+    
+    // Digests of the game files that are written are recorded, so they can be verified later
+    if (!session->options.tarStream && !load_digests(session, digestsPath, packagemanifestSize, &validators)) {
+        return session->error;
+    }
+    session->release->packagemanifestSize = packagemanifestSize;
+    session->release->validators = validators;
+    return LOLDL_OK;
+}
+
+// Everything the loldl tool used to do from main, for one session. Returns the first error
+static LolDLResult run_session(LolDLSession* session)
+{
+    set_stage(session, LOLDL_STAGE_PACKAGEMANIFEST);
+    
+    // Setup CURL
+    session->curl = curl_easy_init();
+    if (!session->curl) {
+        return LOLDL_ERROR_OUT_OF_MEMORY;
+    }
+    curl_easy_setopt(session->curl, CURLOPT_SHARE, session->context->share);
+    curl_easy_setopt(session->curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(session->curl, CURLOPT_XFERINFOFUNCTION, progress_callback);
+    curl_easy_setopt(session->curl, CURLOPT_XFERINFODATA, (void*)session);
+    curl_easy_setopt(session->curl, CURLOPT_WRITEFUNCTION, write_callback);
+    
+    // Load all packagemanifests up front, so game files shared by several game versions are known before downloading
+    for (int i = 0; i < session->numReleases; i++) {
+        session->release = &session->releases[i];
+        if (session->numReleases > 1) {
+            session_print(session, "\n[INFO]: Game version %s\n", session->release->gameVersion);
+        }
+        LolDLResult result = load_release(session);
+        if (result != LOLDL_OK) {
+            return result;
+        }
+    }
+    
+    // Game files are fetched one by one later on
+    if (session->options.lazy) {
+        session->fileEntries = malloc((session->release->stats.numFilesInPackageManifest + 1) * sizeof(FileEntry*));
+        if (!session->fileEntries) {
+            set_out_of_memory(session);
+            return session->error;
+        }
+        for (ListNode* c = session->release->fileList.head; c; c = c->next) {
+            session->fileEntries[c->fileEntry->index] = c->fileEntry;
+        }
+        return session->error;
+    }
+    
+    // Download game files
+    if (session->options.verify && !session->options.tarStream) {
+        for (int i = 0; i < session->numReleases && !is_cancelled(session); i++) {
+            session->release = &session->releases[i];
+            verify_and_repair_game_files(session);
+        }
+    } else if (session->numReleases > 1) {
+        download_releases(session);
+    } else {
+        download_game_files(session);
+    }
+    for (int i = 0; i < session->numReleases; i++) {
+        Release* release = &session->releases[i];
+        if (release->digests) {
+            session->release = release;
+            save_digests(session, release->digestsPath, release->packagemanifestSize, &release->validators);
+        }
+    }
+    return session->error;
+}
+
+// Body of the session's thread
+static void session_main(void* data)
+{
+    LolDLSession* session = (LolDLSession*)data;
+    LolDLResult result = run_session(session);
+    if (result == LOLDL_OK && is_cancelled(session)) {
+        result = LOLDL_ERROR_CANCELLED;
+    }
+    mutex_lock(&session->mutex);
+    session->progress.stage = LOLDL_STAGE_DONE;
+    session->result = result;
+    session->finished = true;
+    mutex_unlock(&session->mutex);
+}
+
+static void share_lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr)
+{
+    mutex_lock(&((LolDLContext*)userptr)->shareLocks[data]);
+}
+
+static void share_unlock(CURL* handle, curl_lock_data data, void* userptr)
+{
+    mutex_unlock(&((LolDLContext*)userptr)->shareLocks[data]);
+}
+
+void loldl_options_init(LolDLOptions* options)
+{
+    *options = (LolDLOptions){.useBINFiles          = true,
+                              .removeExistingFiles  = false,
+                              .keepBINFiles         = false,
+                              .downloadURL          = LOLDL_DEFAULT_URL,
+                              .downloadPath         = LOLDL_DEFAULT_PATH,
+                              .destFolder           = LOLDL_DEFAULT_DEST_FOLDER,
+                              .maxTransfers         = LOLDL_DEFAULT_MAX_TRANSFERS,
+                              .rateLimit            = 0,
+                              .schedulingPolicy     = LOLDL_DEFAULT_SCHEDULING_POLICY};
+}
+
+bool loldl_has_scheduling_policy(const char* name)
+{
+    return find_scheduling_policy(name) != 0;
+}
+
+const char* loldl_result_string(LolDLResult result)
+{
+    switch (result) {
+        case LOLDL_OK:                      return "Success";
+        case LOLDL_PENDING:                 return "Still running";
+        case LOLDL_ERROR_INVALID_ARGUMENT:  return "Invalid argument";
+        case LOLDL_ERROR_OUT_OF_MEMORY:     return "Out of memory";
+        case LOLDL_ERROR_THREAD:            return "Couldn't start thread";
+        case LOLDL_ERROR_PACKAGEMANIFEST:   return "Couldn't get packagemanifest";
+        case LOLDL_ERROR_DOWNLOAD:          return "Some files couldn't be downloaded";
+        case LOLDL_ERROR_MISSING_BIN:       return "BIN file missing";
+        case LOLDL_ERROR_WRITE:             return "Couldn't write files";
+        case LOLDL_ERROR_CANCELLED:         return "Cancelled";
+    }
+    return "Unknown error";
+}
+
+LolDLResult loldl_context_create(LolDLContext** context)
+{
+    *context = 0;
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        return LOLDL_ERROR_OUT_OF_MEMORY;
+    }
+    LolDLContext* newContext = calloc(1, sizeof(LolDLContext));
+    if (!newContext || !(newContext->share = curl_share_init())) {
+        free(newContext);
+        curl_global_cleanup();
+        return LOLDL_ERROR_OUT_OF_MEMORY;
+    }
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        mutex_init(&newContext->shareLocks[i]);
+    }
+    curl_share_setopt(newContext->share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(newContext->share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(newContext->share, CURLSHOPT_USERDATA, (void*)newContext);
+    // Sessions skip DNS lookups and full TLS handshakes for hosts other sessions already talked to. The connection
+    // cache isn't shared, libcurl doesn't support using it from concurrent threads: each session pools its own
+    curl_share_setopt(newContext->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(newContext->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    *context = newContext;
+    return LOLDL_OK;
+}
+
+void loldl_context_destroy(LolDLContext* context)
+{
+    if (!context) {
+        return;
+    }
+    curl_share_cleanup(context->share);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        mutex_destroy(&context->shareLocks[i]);
+    }
+    free(context);
+    curl_global_cleanup();
+}
+
+// One release per game version in the comma separated list options.gameVersion. With several, each one goes to
+// destFolder/<version>. Returns LOLDL_ERROR_INVALID_ARGUMENT if the list is empty, has an empty or too long version
+// or one twice
+static LolDLResult create_releases(LolDLSession* session)
+{
+    char versions[sizeof(session->options.gameVersion)];
+    strcpy(versions, session->options.gameVersion);
+    int numVersions = 1;
+    for (char* c = versions; *c; c++) {
+        numVersions += *c == ',';
+    }
+    session->releases = calloc(numVersions, sizeof(Release));
+    if (!session->releases) {
+        return LOLDL_ERROR_OUT_OF_MEMORY;
+    }
+    char* start = versions;
+    for (int i = 0; i < numVersions; i++) {
+        char* end = strchr(start, ',');
+        if (end) {
+            *end = '\0';
+        }
+        if (!*start || strlen(start) >= sizeof(session->releases[i].gameVersion)) {
+            return LOLDL_ERROR_INVALID_ARGUMENT;
+        }
+        for (int j = 0; j < i; j++) {
+            if (!strcmp(session->releases[j].gameVersion, start)) {
+                return LOLDL_ERROR_INVALID_ARGUMENT;
+            }
+        }
+        Release* release = &session->releases[session->numReleases++];
+        strcpy(release->gameVersion, start);
+        if (numVersions > 1) {
+            sprintf(release->destFolder, "%s/%s", session->options.destFolder, release->gameVersion);
+        } else {
+            strcpy(release->destFolder, session->options.destFolder);
+        }
+        start = end + 1;
+    }
+    session->release = &session->releases[0];
+    return LOLDL_OK;
+}
+
+LolDLResult loldl_session_create(LolDLContext* context, const LolDLOptions* options, LolDLProgressCallback progressCallback,
+                                 LolDLCompletionCallback completionCallback, void* userdata, LolDLSession** session)
+{
+    *session = 0;
+    SchedulingPolicy* policy = find_scheduling_policy(options->schedulingPolicy);
+    if (!context || !options->gameVersion[0] || !policy || (options->tarStream && !options->tarOutput)) {
+        return LOLDL_ERROR_INVALID_ARGUMENT;
+    }
+    LolDLSession* newSession = calloc(1, sizeof(LolDLSession));
+    if (!newSession) {
+        return LOLDL_ERROR_OUT_OF_MEMORY;
+    }
+    newSession->context = context;
+    newSession->options = *options;
+    if (newSession->options.maxTransfers < 1) {
+        newSession->options.maxTransfers = 1;
+    }
+    newSession->schedulingPolicy = policy;
+    // Several game versions are downloaded with range requests, there are no BIN archives to keep or release space of
+    LolDLResult result = create_releases(newSession);
+    if (result == LOLDL_OK && newSession->numReleases > 1 && (newSession->options.tarStream || newSession->options.lazy ||
+                                                              newSession->options.keepBINFiles || newSession->options.punchHoles)) {
+        result = LOLDL_ERROR_INVALID_ARGUMENT;
+    }
+    if (result != LOLDL_OK) {
+        free(newSession->releases);
+        free(newSession);
+        return result;
+    }
+    newSession->progressCallback = progressCallback;
+    newSession->completionCallback = completionCallback;
+    newSession->userdata = userdata;
+    newSession->result = LOLDL_PENDING;
+    atomic_init(&newSession->cancelled, false);
+    atomic_init(&newSession->rateLimit, newSession->options.rateLimit);
+    newSession->rateLimitFromFile = -1;
+    mutex_init(&newSession->mutex);
+    *session = newSession;
+    return LOLDL_OK;
+}
+
+LolDLResult loldl_session_start(LolDLSession* session)
+{
+    if (session->started) {
+        return LOLDL_ERROR_INVALID_ARGUMENT;
+    }
+    session->threadStart = (ThreadStart){session_main, session};
+    if (!thread_create(&session->thread, &session->threadStart)) {
+        return LOLDL_ERROR_THREAD;
+    }
+    session->started = true;
+    return LOLDL_OK;
+}
+
+LolDLResult loldl_session_poll(LolDLSession* session, LolDLProgress* progress, int timeoutMs)
+{
+    if (!session->started) {
+        return LOLDL_ERROR_INVALID_ARGUMENT;
+    }
+    unsigned int timeStart = get_time_ms();
+    LolDLProgress current;
+    LolDLResult result;
+    bool finished;
+    while (true) {
+        mutex_lock(&session->mutex);
+        current = session->progress;
+        result = session->result;
+        finished = session->finished;
+        mutex_unlock(&session->mutex);
+        if (finished || (int)(get_time_ms() - timeStart) >= timeoutMs) {
+            break;
+        }
+        sleep_ms(10);
+    }
+    
+    if (progress) {
+        *progress = current;
+    }
+    if (session->progressCallback && memcmp(&current, &session->reportedProgress, sizeof(current)) != 0) {
+        session->reportedProgress = current;
+        session->progressCallback(session, &current, session->userdata);
+    }
+    if (!finished) {
+        return LOLDL_PENDING;
+    }
+    if (!session->joined) {
+        thread_join(session->thread);
+        session->joined = true;
+        if (session->completionCallback) {
+            session->completionCallback(session, result, session->userdata);
+        }
+    }
+    return result;
+}
+
+void loldl_session_cancel(LolDLSession* session)
+{
+    atomic_store(&session->cancelled, true);
+}
+
+void loldl_session_set_rate_limit(LolDLSession* session, unsigned int rateLimit)
+{
+    // Picked up by the session's thread on its next token refill
+    atomic_store(&session->rateLimit, rateLimit);
+}
+
+int loldl_session_file_count(LolDLSession* session)
+{
+    if (!session->fileEntries || !session->joined || session->result != LOLDL_OK) {
+        return -1;
+    }
+    return session->release->stats.numFilesInPackageManifest;
+}
+
+LolDLResult loldl_session_file_info(LolDLSession* session, int index, LolDLFileInfo* info)
+{
+    if (index < 0 || index >= loldl_session_file_count(session)) {
+        return LOLDL_ERROR_INVALID_ARGUMENT;
+    }
+    FileEntry* entry = session->fileEntries[index];
+    get_final_file_name(entry, info->fileName);
+    info->path = info->fileName + strlen(session->release->destFolder);
+    while (*info->path == '/') {
+        info->path++;
+    }
+    info->compressedSize = entry->size;
+    info->size = 0;
+    mutex_lock(&session->mutex);
+    if (session->release->digests && session->release->digests[entry->index].valid) {
+        info->size = session->release->digests[entry->index].size;
+    }
+    mutex_unlock(&session->mutex);
+    return LOLDL_OK;
+}
+
+// Receives the compressed bytes of a game file fetched on its own
+typedef struct {
+    unsigned char* data;
+    unsigned int size;
+    unsigned int received;
+} FetchBuffer;
+
+static size_t fetch_write_callback(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    FetchBuffer* buffer = (FetchBuffer*)userdata;
+    size_t length = size * nmemb;
+    if (length > buffer->size - buffer->received) {
+        // More than the game file, e.g. a server that ignored the range
+        return 0;
+    }
+    memcpy(buffer->data + buffer->received, ptr, length);
+    buffer->received += length;
+    return length;
+}
+
+// Take an idle handle for fetching a game file, or make a new one when all of them are in use by other threads
+static CURL* take_fetch_handle(LolDLSession* session)
+{
+    CURL* curl = 0;
+    mutex_lock(&session->mutex);
+    if (session->numFetchHandles > 0) {
+        curl = session->fetchHandles[--session->numFetchHandles];
+    }
+    mutex_unlock(&session->mutex);
+    if (!curl && (curl = curl_easy_init())) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, session->context->share);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, fetch_write_callback);
+        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    }
+    return curl;
+}
+
+static void return_fetch_handle(LolDLSession* session, CURL* curl)
+{
+    mutex_lock(&session->mutex);
+    if (session->numFetchHandles == session->fetchHandlesCapacity) {
+        int capacity = session->fetchHandlesCapacity ? session->fetchHandlesCapacity * 2 : 4;
+        CURL** handles = realloc(session->fetchHandles, capacity * sizeof(CURL*));
+        if (handles) {
+            session->fetchHandles = handles;
+            session->fetchHandlesCapacity = capacity;
+        }
+    }
+    if (session->numFetchHandles < session->fetchHandlesCapacity) {
+        session->fetchHandles[session->numFetchHandles++] = curl;
+        curl = 0;
+    }
+    mutex_unlock(&session->mutex);
+    if (curl) {
+        curl_easy_cleanup(curl);
+    }
+}
+
+LolDLResult loldl_session_fetch_file(LolDLSession* session, int index)
+{
+    static atomic_uint fetchCount;  // Keeps temporary files of concurrent fetches apart
+    if (index < 0 || index >= loldl_session_file_count(session)) {
+        return LOLDL_ERROR_INVALID_ARGUMENT;
+    }
+    FileEntry* entry = session->fileEntries[index];
+    FetchBuffer buffer = {.data = malloc(entry->size ? entry->size : 1), .size = entry->size};
+    if (!buffer.data) {
+        return LOLDL_ERROR_OUT_OF_MEMORY;
+    }
+    
+    // Get the compressed bytes from the BIN archive (on disk if it is complete) or the individual file
+    LolDLResult result = LOLDL_OK;
+    FileArchiveEntry* archive = session->options.useBINFiles ? find_BIN_archive(session, entry->BIN) : 0;
+    if (session->options.useBINFiles && !archive) {
+        result = LOLDL_ERROR_MISSING_BIN;
+    } else if (archive && is_BIN_archive_complete(archive)) {
+        FILE* archiveFile = fopen(archive->fileName, "rb");
+        if (!archiveFile || fseek(archiveFile, entry->offsetInBIN, SEEK_SET) != 0 || fread(buffer.data, 1, entry->size, archiveFile) != entry->size) {
+            result = LOLDL_ERROR_MISSING_BIN;
+        }
+        if (archiveFile) {
+            fclose(archiveFile);
+        }
+    } else {
+        CURL* curl = take_fetch_handle(session);
+        if (!curl) {
+            free(buffer.data);
+            return LOLDL_ERROR_OUT_OF_MEMORY;
+        }
+        char range[32];
+        sprintf(range, "%u-%u", entry->offsetInBIN, entry->offsetInBIN + entry->size - 1);
+        curl_easy_setopt(curl, CURLOPT_URL, archive ? archive->link : entry->link);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&buffer);
+        curl_easy_setopt(curl, CURLOPT_RANGE, archive ? range : NULL);
+        CURLcode ret = curl_easy_perform(curl);
+        long responseCode = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, NULL);
+        return_fetch_handle(session, curl);
+        if (ret != CURLE_OK || buffer.received != entry->size || (archive && responseCode != 206)) {
+            result = LOLDL_ERROR_DOWNLOAD;
+        }
+    }
+    
+    // Inflate into a temporary file first, so the game file is never seen half written
+    char finalFileName[MAX_PATH];
+    char tempFileName[MAX_PATH + 32];
+    get_final_file_name(entry, finalFileName);
+    sprintf(tempFileName, "%s.%u.part", finalFileName, atomic_fetch_add(&fetchCount, 1));
+    InflatedFile tempFile;
+    if (result == LOLDL_OK) {
+        char dir[MAX_PATH];
+        strcpy(dir, finalFileName);
+        char* lastSlash = strrchr(dir, '/');
+        if (lastSlash) {
+            *lastSlash = '\0';
+            make_path(dir);
+        }
+        tempFile.file = fopen(tempFileName, "wb");
+        if (!tempFile.file) {
+            result = LOLDL_ERROR_WRITE;
+        } else {
+            hash_init(&tempFile.hash);
+            int ret = inf_buffer(buffer.data, entry->size, file_write_callback, &tempFile);
+            if (fclose(tempFile.file) != 0 || ret == Z_ERRNO) {
+                result = LOLDL_ERROR_WRITE;
+            } else if (ret != Z_OK) {
+                result = LOLDL_ERROR_DOWNLOAD;
+            }
+        }
+    }
+    if (result == LOLDL_OK) {
+        remove(finalFileName);
+        if (rename(tempFileName, finalFileName) != 0) {
+            result = LOLDL_ERROR_WRITE;
+        }
+    }
+    if (result == LOLDL_OK) {
+        // Saved when the session is destroyed, so -V can verify fetched game files later
+        mutex_lock(&session->mutex);
+        record_inflated_digest(session->release, entry, &tempFile);
+        session->fetchedDigests = true;
+        mutex_unlock(&session->mutex);
+    } else {
+        remove(tempFileName);
+    }
+    free(buffer.data);
+    return result;
+}
+
+static void free_file_list(FileList* list, bool freeEntries)
+{
+    ListNode* c = list->head;
+    while (c) {
+        ListNode* next = c->next;
+        if (freeEntries) {
+            free(c->fileEntry);
+        }
+        free(c);
+        c = next;
+    }
+    *list = (FileList){0};
+}
+
+void loldl_session_destroy(LolDLSession* session)
+{
+    if (!session) {
+        return;
+    }
+    if (session->started && !session->joined) {
+        loldl_session_cancel(session);
+        thread_join(session->thread);
+    }
+    if (session->fetchedDigests && session->release->digests) {
+        save_digests(session, session->release->digestsPath, session->release->packagemanifestSize, &session->release->validators);
+    }
+    for (int i = 0; i < session->numFetchHandles; i++) {
+        curl_easy_cleanup(session->fetchHandles[i]);
+    }
+    free(session->fetchHandles);
+    for (int i = 0; i < session->numReleases; i++) {
+        Release* release = &session->releases[i];
+        free_file_list(&release->fileList, release->ownsEntries);
+        free_file_list(&release->fileArchiveList, release->ownsEntries);
+        free(release->indexFileEntries);
+        free(release->indexFileArchiveEntries);
+        free(release->digests);
+        unmap_file(&release->packagemanifestIndex);
+    }
+    free(session->releases);
+    free(session->fileEntries);
+    if (session->curl) {
+        curl_easy_cleanup(session->curl);
+    }
+    mutex_destroy(&session->mutex);
+    free(session);
+}
@@ -0,0 +1,127 @@
+#ifndef LOLDL_H
+#define LOLDL_H
+
+// libloldl: downloads League of Legends game files from packagemanifest based releases.
+//
+// A context holds what sessions share (libcurl's DNS and TLS session caches) and is created once per process.
+// A session is one download of one game version: it runs on its own thread once started, and is driven by
+// polling it, which is also where its callbacks are called from. Many sessions can run at the same time as
+// long as their destination folders differ. Functions of a session must not be called from more than one
+// thread at a time.
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define LOLDL_DEFAULT_PATH "/releases/live"
+#define LOLDL_DEFAULT_URL "l3cdn.riotgames.com"
+#define LOLDL_DEFAULT_DEST_FOLDER "lol"
+#define LOLDL_DEFAULT_MAX_TRANSFERS 1
+#define LOLDL_DEFAULT_SCHEDULING_POLICY "largest"
+
+typedef struct LolDLContext_t LolDLContext;
+typedef struct LolDLSession_t LolDLSession;
+
+typedef enum {
+    LOLDL_OK = 0,
+    LOLDL_PENDING,                      // Session is still running
+    LOLDL_ERROR_INVALID_ARGUMENT,
+    LOLDL_ERROR_OUT_OF_MEMORY,
+    LOLDL_ERROR_THREAD,                 // Couldn't start the session's thread
+    LOLDL_ERROR_PACKAGEMANIFEST,        // packagemanifest couldn't be downloaded or is invalid
+    LOLDL_ERROR_DOWNLOAD,               // At least one game file or BIN archive couldn't be downloaded
+    LOLDL_ERROR_MISSING_BIN,            // A BIN archive needed for extracting isn't there
+    LOLDL_ERROR_WRITE,                  // A file (or the tar stream) couldn't be written
+    LOLDL_ERROR_CANCELLED
+} LolDLResult;
+
+// Options of a session, initialize with loldl_options_init
+typedef struct {
+    bool useBINFiles;           // Download BIN_0xXXXXXXXX file archives which contain multiple game files instead of downloading files individually
+    bool removeExistingFiles;   // Remove existing files and redownload them
+    bool keepBINFiles;          // Don't remove BIN files after extracting game files
+    bool punchHoles;            // Release extracted regions of BIN files while extracting, to reduce peak disk usage
+    bool tarStream;             // Write game files as a tar stream to tarOutput instead of storing them in destFolder
+    bool verify;                // Verify existing game files and only download the ones that are missing or damaged
+    bool printOutput;           // Print messages and progress bars to stdout, like the loldl tool does
+    bool lazy;                  // Only load packagemanifest, game files are then fetched one by one with loldl_session_fetch_file
+    char downloadURL[64];       // e.g. l3cdn.riotgames.com
+    char downloadPath[64];      // e.g. /releases/live
+    char gameVersion[256];      // e.g. 0.0.0.130, or a comma separated list of versions that are downloaded together, each to destFolder/<version>.
+                                // Several versions can't be combined with tarStream, lazy, keepBINFiles or punchHoles, and their existing
+                                // game files are kept (unless removeExistingFiles) instead of being extracted again
+    char destFolder[64];        // e.g. lol
+    int maxTransfers;           // Number of transfers that run in parallel
+    int maxAdaptiveTransfers;   // When not 0, the number of parallel transfers starts at maxTransfers and adapts to the measured throughput, up to this
+    unsigned int rateLimit;     // Download rate limit of the session in bytes per second, 0 means unlimited
+    char rateLimitFile[64];     // File that is re-read while downloading to change the rate limit (in KiB/s) at runtime
+    char schedulingPolicy[16];  // Order in which transfers are started: largest, smallest or manifest
+    FILE* tarOutput;            // Where the tar stream is written when tarStream is set
+} LolDLOptions;
+
+typedef enum {
+    LOLDL_STAGE_STARTING,
+    LOLDL_STAGE_PACKAGEMANIFEST,        // Downloading and parsing packagemanifest
+    LOLDL_STAGE_DOWNLOADING,            // Downloading BIN archives or game files (or streaming them)
+    LOLDL_STAGE_EXTRACTING,             // Extracting game files from BIN archives
+    LOLDL_STAGE_VERIFYING,              // Hashing existing game files
+    LOLDL_STAGE_DONE
+} LolDLStage;
+
+typedef struct {
+    LolDLStage stage;
+    unsigned int bytesTotal;            // Bytes to be downloaded in this stage
+    unsigned int bytesDone;
+    unsigned int speedInBytesPerSecond;
+    int filesTotal;                     // Game files to be extracted or verified in this stage
+    int filesDone;
+    int queueDepth;                     // Transfers not started yet
+    int inFlightTransfers;
+    unsigned int inFlightBytes;         // Bytes still to be received by the running transfers
+} LolDLProgress;
+
+// A game file of a lazy session
+typedef struct {
+    char fileName[1024];                // Where the game file is stored once it is fetched
+    const char* path;                   // fileName relative to destFolder, e.g. DATA/Characters/Annie/Annie.skn
+    unsigned int compressedSize;
+    unsigned int size;                  // Size after inflating, 0 if it isn't known (no digest was recorded for it)
+} LolDLFileInfo;
+
+// Called from loldl_session_poll whenever progress changed since the last call
+typedef void (*LolDLProgressCallback)(LolDLSession* session, const LolDLProgress* progress, void* userdata);
+// Called once, from the loldl_session_poll call that sees the session finish
+typedef void (*LolDLCompletionCallback)(LolDLSession* session, LolDLResult result, void* userdata);
+
+void loldl_options_init(LolDLOptions* options);
+// Returns true if name is one of the scheduling policies accepted in LolDLOptions
+bool loldl_has_scheduling_policy(const char* name);
+const char* loldl_result_string(LolDLResult result);
+
+// Not thread-safe: create the context before starting any other thread that uses libcurl
+LolDLResult loldl_context_create(LolDLContext** context);
+// All sessions of the context must have been destroyed
+void loldl_context_destroy(LolDLContext* context);
+
+LolDLResult loldl_session_create(LolDLContext* context, const LolDLOptions* options, LolDLProgressCallback progressCallback,
+                                 LolDLCompletionCallback completionCallback, void* userdata, LolDLSession** session);
+// Start the session in the background and return immediately
+LolDLResult loldl_session_start(LolDLSession* session);
+// Wait up to timeoutMs for the session to finish, call its callbacks and fill progress (may be 0).
+// Returns LOLDL_PENDING while it is still running, otherwise its result
+LolDLResult loldl_session_poll(LolDLSession* session, LolDLProgress* progress, int timeoutMs);
+// Ask the session to stop as soon as possible, it finishes with LOLDL_ERROR_CANCELLED. Can be called from any thread
+void loldl_session_cancel(LolDLSession* session);
+// Change the session's download rate limit in bytes per second (0 means unlimited) while it runs. Can be called from any thread
+void loldl_session_set_rate_limit(LolDLSession* session, unsigned int rateLimit);
+// Cancels the session if it is still running and waits for it
+void loldl_session_destroy(LolDLSession* session);
+
+// Game files of a lazy session, once it finished successfully. Returns -1 if there are none
+int loldl_session_file_count(LolDLSession* session);
+LolDLResult loldl_session_file_info(LolDLSession* session, int index, LolDLFileInfo* info);
+// Fetch only this game file with a range request (or read it from its BIN archive if that is complete on disk),
+// inflate it and store it at its fileName. Its digest is saved when the session is destroyed, so verifying (-V)
+// covers fetched game files. Unlike other functions of a session, it can be called from several threads at a time
+LolDLResult loldl_session_fetch_file(LolDLSession* session, int index);
+
+#endif
@@ -0,0 +1,400 @@
+// loldlfs: mounts a game version as a read-only filesystem. Directory listings come from packagemanifest,
+// game files are only fetched (with a range request on their BIN archive) and inflated on their first open,
+// then served from the local copy in the destination folder. Needs libfuse 3, so it is only built where that is available.
+
+#define FUSE_USE_VERSION 31
+#define _POSIX_C_SOURCE 200809L // pread
+
+#include "loldl.h"
+
+#include <fuse.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_PREFETCH_THREADS 16
+
+typedef enum {
+    FILE_NOT_FETCHED,
+    FILE_FETCHING,
+    FILE_FETCHED
+} FileState;
+
+// File or directory of the mounted tree
+typedef struct Node_t {
+    char* name;
+    int fileIndex;              // -1 for directories
+    struct Node_t* children;
+    struct Node_t* next;
+} Node;
+
+static LolDLSession* g_session;
+static Node g_root = {"", -1, 0, 0};
+static FileState* g_fileStates;
+static int g_numFiles;
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_fetchedCond = PTHREAD_COND_INITIALIZER;  // Signalled whenever a fetch ends
+static pthread_t g_prefetchThreads[MAX_PREFETCH_THREADS];
+static int g_numPrefetchThreads;
+static int g_nextPrefetch;      // Next file index looked at by the prefetch threads
+static bool g_stopPrefetch;
+
+static Node* find_child(Node* dir, const char* name, size_t nameLength)
+{
+    for (Node* c = dir->children; c; c = c->next) {
+        if (strlen(c->name) == nameLength && !strncmp(c->name, name, nameLength)) {
+            return c;
+        }
+    }
+    return 0;
+}
+
+static void add_file(const char* path, int fileIndex)
+{
+    Node* dir = &g_root;
+    while (*path) {
+        const char* slash = strchr(path, '/');
+        size_t nameLength = slash ? (size_t)(slash - path) : strlen(path);
+        Node* node = find_child(dir, path, nameLength);
+        if (!node) {
+            node = calloc(1, sizeof(Node));
+            if (!node || !(node->name = strndup(path, nameLength))) {
+                printf("[ERROR]: Out of memory\n");
+                exit(1);
+            }
+            node->fileIndex = slash ? -1 : fileIndex;
+            node->next = dir->children;
+            dir->children = node;
+        }
+        if (!slash) {
+            return;
+        }
+        dir = node;
+        path = slash + 1;
+    }
+}
+
+static void free_nodes(Node* node)
+{
+    while (node) {
+        Node* next = node->next;
+        free_nodes(node->children);
+        free(node->name);
+        free(node);
+        node = next;
+    }
+}
+
+static Node* find_node(const char* path)
+{
+    Node* node = &g_root;
+    while (node && *path) {
+        if (*path == '/') {
+            path++;
+            continue;
+        }
+        const char* slash = strchr(path, '/');
+        size_t nameLength = slash ? (size_t)(slash - path) : strlen(path);
+        node = find_child(node, path, nameLength);
+        path += nameLength;
+    }
+    return node;
+}
+
+// Fetch the game file unless it is already there. Concurrent calls for the same file wait for the first one
+static int ensure_fetched(int fileIndex)
+{
+    pthread_mutex_lock(&g_mutex);
+    while (g_fileStates[fileIndex] == FILE_FETCHING) {
+        pthread_cond_wait(&g_fetchedCond, &g_mutex);
+    }
+    if (g_fileStates[fileIndex] == FILE_FETCHED) {
+        pthread_mutex_unlock(&g_mutex);
+        return 0;
+    }
+    g_fileStates[fileIndex] = FILE_FETCHING;
+    pthread_mutex_unlock(&g_mutex);
+
+    LolDLResult result = loldl_session_fetch_file(g_session, fileIndex);
+
+    pthread_mutex_lock(&g_mutex);
+    g_fileStates[fileIndex] = result == LOLDL_OK ? FILE_FETCHED : FILE_NOT_FETCHED;
+    pthread_cond_broadcast(&g_fetchedCond);
+    pthread_mutex_unlock(&g_mutex);
+    if (result != LOLDL_OK) {
+        LolDLFileInfo info;
+        loldl_session_file_info(g_session, fileIndex, &info);
+        fprintf(stderr, "[ERROR]: Couldn't fetch %s: %s\n", info.path, loldl_result_string(result));
+        return -EIO;
+    }
+    return 0;
+}
+
+// Body of the prefetch threads: fetch all game files not opened yet, in packagemanifest order
+static void* prefetch_main(void* data)
+{
+    while (true) {
+        pthread_mutex_lock(&g_mutex);
+        while (g_nextPrefetch < g_numFiles && g_fileStates[g_nextPrefetch] != FILE_NOT_FETCHED) {
+            g_nextPrefetch++;
+        }
+        int fileIndex = g_nextPrefetch++;
+        bool stop = g_stopPrefetch || fileIndex >= g_numFiles;
+        pthread_mutex_unlock(&g_mutex);
+        if (stop) {
+            return 0;
+        }
+        ensure_fetched(fileIndex);
+    }
+}
+
+static void* fs_init(struct fuse_conn_info* conn, struct fuse_config* config)
+{
+    // Sizes change once a file is fetched, so they must not be cached by the kernel
+    config->attr_timeout = 0;
+    for (int i = 0; i < g_numPrefetchThreads; i++) {
+        if (pthread_create(&g_prefetchThreads[i], 0, prefetch_main, 0) != 0) {
+            fprintf(stderr, "[WARNING]: Couldn't start prefetch thread\n");
+            g_numPrefetchThreads = i;
+            break;
+        }
+    }
+    return 0;
+}
+
+static void fs_destroy(void* data)
+{
+    pthread_mutex_lock(&g_mutex);
+    g_stopPrefetch = true;
+    pthread_mutex_unlock(&g_mutex);
+    for (int i = 0; i < g_numPrefetchThreads; i++) {
+        pthread_join(g_prefetchThreads[i], 0);
+    }
+}
+
+static int fs_getattr(const char* path, struct stat* st, struct fuse_file_info* fi)
+{
+    Node* node = find_node(path);
+    if (!node) {
+        return -ENOENT;
+    }
+    memset(st, 0, sizeof(struct stat));
+    if (node->fileIndex < 0) {
+        st->st_mode = S_IFDIR | 0555;
+        st->st_nlink = 2;
+        return 0;
+    }
+    st->st_mode = S_IFREG | 0444;
+    st->st_nlink = 1;
+
+    // Until a file is fetched its size is only known if a digest was recorded for it, otherwise it is the compressed size
+    LolDLFileInfo info;
+    loldl_session_file_info(g_session, node->fileIndex, &info);
+    pthread_mutex_lock(&g_mutex);
+    bool fetched = g_fileStates[node->fileIndex] == FILE_FETCHED;
+    pthread_mutex_unlock(&g_mutex);
+    struct stat fetchedStat;
+    if (fetched && stat(info.fileName, &fetchedStat) == 0) {
+        st->st_size = fetchedStat.st_size;
+        st->st_mtime = fetchedStat.st_mtime;
+    } else {
+        st->st_size = info.size ? info.size : info.compressedSize;
+    }
+    return 0;
+}
+
+static int fs_readdir(const char* path, void* buffer, fuse_fill_dir_t filler, off_t offset,
+                      struct fuse_file_info* fi, enum fuse_readdir_flags flags)
+{
+    Node* node = find_node(path);
+    if (!node) {
+        return -ENOENT;
+    }
+    if (node->fileIndex >= 0) {
+        return -ENOTDIR;
+    }
+    filler(buffer, ".", 0, 0, 0);
+    filler(buffer, "..", 0, 0, 0);
+    for (Node* c = node->children; c; c = c->next) {
+        filler(buffer, c->name, 0, 0, 0);
+    }
+    return 0;
+}
+
+static int fs_open(const char* path, struct fuse_file_info* fi)
+{
+    Node* node = find_node(path);
+    if (!node) {
+        return -ENOENT;
+    }
+    if (node->fileIndex < 0) {
+        return -EISDIR;
+    }
+    if ((fi->flags & O_ACCMODE) != O_RDONLY) {
+        return -EROFS;
+    }
+    int ret = ensure_fetched(node->fileIndex);
+    if (ret != 0) {
+        return ret;
+    }
+    LolDLFileInfo info;
+    loldl_session_file_info(g_session, node->fileIndex, &info);
+    int fd = open(info.fileName, O_RDONLY);
+    if (fd < 0) {
+        return -errno;
+    }
+    fi->fh = (uint64_t)fd;
+    // The size reported before the open may have been a placeholder, so reads go to the file until its end
+    fi->direct_io = 1;
+    return 0;
+}
+
+static int fs_read(const char* path, char* buffer, size_t size, off_t offset, struct fuse_file_info* fi)
+{
+    ssize_t length = pread((int)fi->fh, buffer, size, offset);
+    return length < 0 ? -errno : (int)length;
+}
+
+static int fs_release(const char* path, struct fuse_file_info* fi)
+{
+    close((int)fi->fh);
+    return 0;
+}
+
+static const struct fuse_operations g_operations = {
+    .init = fs_init,
+    .destroy = fs_destroy,
+    .getattr = fs_getattr,
+    .readdir = fs_readdir,
+    .open = fs_open,
+    .read = fs_read,
+    .release = fs_release,
+};
+
+int main(int argc, char *argv[])
+{
+    LolDLOptions options;
+    loldl_options_init(&options);
+    options.printOutput = true;
+    options.lazy = true;
+
+    // Parse program parameters
+    bool hasSpecifiedGameVersion = false;
+    bool foreground = false;
+    char* mountPoint = 0;
+    char* programName = argv[0];
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp("-u", argv[i])) {
+            strcpy(options.downloadURL, argv[++i]);
+        } else if (!strcmp("-p", argv[i])) {
+            strcpy(options.downloadPath, argv[++i]);
+        } else if (!strcmp("-v", argv[i])) {
+            strcpy(options.gameVersion, argv[++i]);
+            hasSpecifiedGameVersion = true;
+        } else if (!strcmp("-d", argv[i])) {
+            strcpy(options.destFolder, argv[++i]);
+        } else if (!strcmp("-h", argv[i])) {
+            printf("Usage: %s [options] -v VERSION MOUNTPOINT\n", programName);
+            printf("  -v VERSION\t: Mount game version specified in VERSION\n");
+            printf("  MOUNTPOINT\t: Directory where game files are shown, each one is fetched on its first open\n");
+            printf("Options:\n");
+            printf("  -u URL\t: Use URL as download URL (default: %s)\n", LOLDL_DEFAULT_URL);
+            printf("  -p PATH\t: Use PATH as download path (default: %s)\n", LOLDL_DEFAULT_PATH);
+            printf("  -d DIRECTORY\t: Store fetched files in DIRECTORY (default: %s)\n", LOLDL_DEFAULT_DEST_FOLDER);
+            printf("  -h\t\t: Print this help text and exit\n");
+            printf("  -i\t\t: (NOT RECOMMENDED) Fetch files individually instead of from BIN archives (default: disabled)\n");
+            printf("  -r\t\t: Fetch files again even if they are already in DIRECTORY (default: disabled)\n");
+            printf("  -b COUNT\t: Fetch all files in the background with COUNT threads, up to %d (default: 0)\n", MAX_PREFETCH_THREADS);
+            printf("  -f\t\t: Stay in the foreground (default: disabled)\n");
+            exit(0);
+        } else if (!strcmp("-i", argv[i])) {
+            options.useBINFiles = false;
+        } else if (!strcmp("-r", argv[i])) {
+            options.removeExistingFiles = true;
+        } else if (!strcmp("-b", argv[i])) {
+            g_numPrefetchThreads = atoi(argv[++i]);
+            if (g_numPrefetchThreads < 0) {
+                g_numPrefetchThreads = 0;
+            } else if (g_numPrefetchThreads > MAX_PREFETCH_THREADS) {
+                g_numPrefetchThreads = MAX_PREFETCH_THREADS;
+            }
+        } else if (!strcmp("-f", argv[i])) {
+            foreground = true;
+        } else if (argv[i][0] == '-') {
+            printf("Unknown option %s\n", argv[i]);
+        } else {
+            mountPoint = argv[i];
+        }
+    }
+
+    // Game version and mount point are required
+    if (!hasSpecifiedGameVersion || !mountPoint) {
+        printf("%s: No game version or mount point specified, exiting program.\nIf you need help using this program, run: %s -h\n", programName, programName);
+        exit(0);
+    }
+
+    // The filesystem runs in / once it is in the background, so the destination folder has to be absolute
+    if (options.destFolder[0] != '/') {
+        char absoluteDestFolder[1024];
+        if (!getcwd(absoluteDestFolder, sizeof(absoluteDestFolder))
+            || strlen(absoluteDestFolder) + 1 + strlen(options.destFolder) >= sizeof(options.destFolder)) {
+            printf("[ERROR]: Destination folder path is too long, use a shorter absolute path with -d\n");
+            exit(1);
+        }
+        strcat(absoluteDestFolder, "/");
+        strcat(absoluteDestFolder, options.destFolder);
+        strcpy(options.destFolder, absoluteDestFolder);
+    }
+
+    // Only packagemanifest is loaded here, game files are fetched by the filesystem
+    LolDLContext* context = 0;
+    LolDLResult result = loldl_context_create(&context);
+    if (result == LOLDL_OK) {
+        result = loldl_session_create(context, &options, 0, 0, 0, &g_session);
+    }
+    if (result == LOLDL_OK) {
+        result = loldl_session_start(g_session);
+    }
+    while (result == LOLDL_OK && (result = loldl_session_poll(g_session, 0, 1000)) == LOLDL_PENDING) {
+    }
+    int ret = 1;
+    if (result != LOLDL_OK) {
+        printf("\n[ERROR]: %s\n", loldl_result_string(result));
+    } else {
+        // Build the tree, files that are already there count as fetched
+        g_numFiles = loldl_session_file_count(g_session);
+        g_fileStates = calloc(g_numFiles + 1, sizeof(FileState));
+        if (!g_fileStates) {
+            printf("[ERROR]: Out of memory\n");
+            exit(1);
+        }
+        for (int i = 0; i < g_numFiles; i++) {
+            LolDLFileInfo info;
+            loldl_session_file_info(g_session, i, &info);
+            add_file(info.path, i);
+            if (!options.removeExistingFiles && access(info.fileName, F_OK) == 0) {
+                g_fileStates[i] = FILE_FETCHED;
+            }
+        }
+        printf("\n[INFO]: Mounting %d game files at %s\n", g_numFiles, mountPoint);
+        fflush(stdout);
+
+        char* fuseArgv[] = {programName, mountPoint, "-o", "ro", foreground ? "-f" : 0, 0};
+        ret = fuse_main(foreground ? 5 : 4, fuseArgv, &g_operations, 0);
+
+        free_nodes(g_root.children);
+        free(g_fileStates);
+    }
+
+    // Cleanup
+    loldl_session_destroy(g_session);
+    loldl_context_destroy(context);
+
+    return ret;
+}
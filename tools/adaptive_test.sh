@@ -0,0 +1,45 @@
+#!/bin/sh
+# Runs loldl with the adaptive concurrency controller (-a) against the local test server while bandwidth changes
+# according to tools/adaptive_steps.txt, and prints the controller's decisions next to the bandwidth steps.
+#
+# Expected, in about two minutes: parallel downloads climb to 8 during the first step. In the second one, time to
+# first byte rises as downloads queue up at the narrower link, so they are cut by a quarter, then every extra one is
+# taken back because it doesn't raise throughput, which stays at the link's rate. In the third one they get halved
+# on 503 responses and the run still succeeds, since busy responses don't use up a transfer's attempts.
+#
+# Fails if the server doesn't start, if loldl fails or if the controller made no decisions.
+#
+# Usage: tools/adaptive_test.sh [LOLDL [PORT]] (defaults: ./loldl, build it with build.sh first, and a free port)
+
+LOLDL=${1:-./loldl}
+TOOLS=$(dirname "$0")
+WORK=$(mktemp -d)
+PORT=${2:-$(python3 -c 'import socket; s = socket.socket(); s.bind(("127.0.0.1", 0)); print(s.getsockname()[1])')}
+
+python3 "$TOOLS/make_test_release.py" -r "$WORK/www" -v 0.0.0.1 -n 90 -b 4 -s 4194304 || exit 1
+python3 "$TOOLS/test_server.py" -p $PORT -r "$WORK/www" -s "$TOOLS/adaptive_steps.txt" 2> "$WORK/server.log" &
+SERVER=$!
+sleep 1
+if ! kill -0 $SERVER 2> /dev/null; then
+    echo "The test server didn't start on port $PORT:"
+    cat "$WORK/server.log"
+    rm -rf "$WORK"
+    exit 1
+fi
+
+"$LOLDL" -u localhost:$PORT -v 0.0.0.1 -d "$WORK/lol" -j 2 -a 8 > "$WORK/loldl.log" 2>&1
+RESULT=$?
+
+kill $SERVER
+echo "Bandwidth steps:"
+grep "total" "$WORK/server.log"
+echo "Controller decisions:"
+tr '\r' '\n' < "$WORK/loldl.log" | grep "Parallel downloads [0-9]* ->"
+DECIDED=$?
+echo "loldl exited with $RESULT"
+rm -rf "$WORK"
+if [ $DECIDED -ne 0 ]; then
+    echo "The controller never changed the number of parallel downloads"
+    exit 1
+fi
+exit $RESULT
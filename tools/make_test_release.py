@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+# Build a fake release for tools/test_server.py: random game files packed into BIN archives plus a packagemanifest,
+# laid out like the CDN so loldl can be pointed at it with -u localhost:PORT.
+#
+# Usage: make_test_release.py [-r ROOT] [-v VERSION] [-n FILES] [-b BINS] [-s MAX_FILE_SIZE]
+
+import argparse
+import os
+import random
+import zlib
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Fake release for the local test server')
+    parser.add_argument('-r', '--root', default='www')
+    parser.add_argument('-v', '--version', default='0.0.0.1')
+    parser.add_argument('-n', '--files', type=int, default=40)
+    parser.add_argument('-b', '--bins', type=int, default=4)
+    parser.add_argument('-s', '--max-file-size', type=int, default=4 * 1024 * 1024)
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    random.seed(args.seed)
+    release = '/projects/lol_game_client/releases/' + args.version
+    base = os.path.join(args.root, 'releases/live' + release)
+    os.makedirs(base + '/packages/files', exist_ok=True)
+    archives = [bytearray() for _ in range(args.bins)]
+    lines = []
+    for i in range(args.files):
+        # Random bytes don't compress, so sizes on the wire stay close to MAX_FILE_SIZE
+        data = random.randbytes(random.randint(1, args.max_file_size))
+        compressed = zlib.compress(data)
+        archive = archives[i % args.bins]
+        path = '%s/files/DATA/Dir%d/File%d.dat.compressed' % (release, i % 8, i)
+        lines.append('%s,BIN_0x%08x,%d,%d,0\r\n' % (path, i % args.bins, len(archive), len(compressed)))
+        archive += compressed
+        individual = os.path.join(args.root, 'releases/live' + path)
+        os.makedirs(os.path.dirname(individual), exist_ok=True)
+        with open(individual, 'wb') as file:
+            file.write(compressed)
+    for i, archive in enumerate(archives):
+        with open('%s/packages/files/BIN_0x%08x' % (base, i), 'wb') as file:
+            file.write(archive)
+    with open(base + '/packages/files/packagemanifest', 'w', newline='') as file:
+        file.write('PKG1\r\n' + ''.join(lines))
+    print('%s: %d files in %d BIN archives, %d bytes' % (args.version, args.files, args.bins, sum(map(len, archives))))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+# Local stand-in for the release CDN, used to test loldl against controlled network conditions.
+#
+# Serves ROOT over HTTP/1.1 with Range, HEAD, ETag and If-None-Match / If-Modified-Since support. Responses go
+# through a bottleneck link shared by all connections: chunks are sent in FIFO order at the link's rate, so like
+# on a real network, time to first byte grows with the number of downloads that queue up at the bottleneck.
+# There is also an optional per-connection rate and an optional connection limit above which requests get 503
+# (like an overloaded CDN edge).
+#
+# Bandwidth can change while loldl runs, from a script with one step per line:
+#     SECONDS TOTAL_KIB_S [CONNECTION_KIB_S [MAX_CONNECTIONS]]
+# Each step applies SECONDS after the server started, 0 means unlimited. Lines starting with # are ignored.
+#
+# Usage: test_server.py [-p PORT] [-r ROOT] [-s SCRIPT] [-t TOTAL_KIB_S] [-c CONNECTION_KIB_S] [-m MAX_CONNECTIONS]
+
+import argparse
+import email.utils
+import hashlib
+import http.server
+import os
+import re
+import sys
+import threading
+import time
+
+CHUNK_SIZE = 16 * 1024
+
+
+class Limits:
+    def __init__(self, total, connection, max_connections):
+        self.lock = threading.Lock()
+        self.total = total                  # Bytes per second shared by all connections, 0 means unlimited
+        self.connection = connection        # Bytes per second of each connection, 0 means unlimited
+        self.max_connections = max_connections
+        self.connections = 0
+        self.time_link_free = time.monotonic()  # When the bottleneck link finishes sending what is queued
+
+    def set(self, total, connection, max_connections):
+        with self.lock:
+            self.total, self.connection, self.max_connections = total, connection, max_connections
+        print('[%s] total %s, per connection %s, max connections %s' % (time.strftime('%H:%M:%S'),
+              describe_rate(total), describe_rate(connection), max_connections or 'unlimited'), file=sys.stderr)
+
+    def acquire_connection(self):
+        with self.lock:
+            if self.max_connections and self.connections >= self.max_connections:
+                return False
+            self.connections += 1
+            return True
+
+    def release_connection(self):
+        with self.lock:
+            self.connections -= 1
+
+    def take(self, count):
+        # Queue count bytes on the bottleneck link and wait for their turn
+        with self.lock:
+            if not self.total:
+                return
+            self.time_link_free = max(self.time_link_free, time.monotonic()) + count / self.total
+            wait = self.time_link_free - time.monotonic()
+        time.sleep(max(0, wait))
+
+
+def describe_rate(rate):
+    return '%d KiB/s' % (rate // 1024) if rate else 'unlimited'
+
+
+def run_script(limits, path):
+    steps = []
+    with open(path) as script:
+        for line in script:
+            fields = line.split()
+            if fields and not fields[0].startswith('#'):
+                values = [int(field) for field in fields] + [0, 0]
+                steps.append((float(fields[0]), values[1] * 1024, values[2] * 1024, values[3]))
+    start = time.monotonic()
+    for at, total, connection, max_connections in sorted(steps):
+        time.sleep(max(0, start + at - time.monotonic()))
+        limits.set(total, connection, max_connections)
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, format, *args):
+        pass
+
+    def send_empty(self, code, headers=()):
+        self.send_response(code)
+        for name, value in headers:
+            self.send_header(name, value)
+        self.send_header('Content-Length', '0')
+        self.end_headers()
+
+    def serve(self, send_body):
+        path = os.path.normpath(os.path.join(self.server.root, self.path.split('?')[0].lstrip('/')))
+        if not path.startswith(self.server.root) or not os.path.isfile(path):
+            self.send_empty(404)
+            return
+        stat = os.stat(path)
+        etag = '"%s"' % hashlib.md5(('%s-%d-%d' % (path, stat.st_size, stat.st_mtime_ns)).encode()).hexdigest()
+        last_modified = email.utils.formatdate(stat.st_mtime, usegmt=True)
+        validators = (('ETag', etag), ('Last-Modified', last_modified))
+        if self.headers.get('If-None-Match') == etag or (not self.headers.get('If-None-Match')
+                                                        and self.headers.get('If-Modified-Since') == last_modified):
+            self.send_empty(304, validators)
+            return
+
+        start, end = 0, stat.st_size - 1
+        range_header = self.headers.get('Range')
+        if range_header:
+            match = re.fullmatch(r'bytes=(\d+)-(\d*)', range_header.strip())
+            if not match or int(match.group(1)) >= stat.st_size:
+                self.send_empty(416, (('Content-Range', 'bytes */%d' % stat.st_size),))
+                return
+            start = int(match.group(1))
+            if match.group(2):
+                end = min(int(match.group(2)), end)
+
+        if send_body and not self.server.limits.acquire_connection():
+            self.send_empty(503)
+            return
+        try:
+            # Headers queue at the bottleneck like everything else
+            self.server.limits.take(512)
+            self.send_response(206 if range_header else 200)
+            if range_header:
+                self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, end, stat.st_size))
+            for name, value in validators:
+                self.send_header(name, value)
+            self.send_header('Content-Length', str(end - start + 1))
+            self.end_headers()
+            if send_body:
+                self.send_file(path, start, end - start + 1)
+        finally:
+            if send_body:
+                self.server.limits.release_connection()
+
+    def send_file(self, path, offset, remaining):
+        limits = self.server.limits
+        with open(path, 'rb') as file:
+            file.seek(offset)
+            time_start = time.monotonic()
+            sent = 0
+            while remaining > 0:
+                chunk = file.read(min(CHUNK_SIZE, remaining))
+                limits.take(len(chunk))
+                if limits.connection:
+                    time.sleep(max(0, time_start + (sent + len(chunk)) / limits.connection - time.monotonic()))
+                self.wfile.write(chunk)
+                sent += len(chunk)
+                remaining -= len(chunk)
+
+    def do_GET(self):
+        self.serve(True)
+
+    def do_HEAD(self):
+        self.serve(False)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Throttling stand-in for the release CDN')
+    parser.add_argument('-p', '--port', type=int, default=8765)
+    parser.add_argument('-r', '--root', default='www', help='Directory served as the server root')
+    parser.add_argument('-s', '--script', help='Bandwidth script, see the top of this file')
+    parser.add_argument('-t', '--total', type=int, default=0, help='Shared bandwidth in KiB/s')
+    parser.add_argument('-c', '--connection', type=int, default=0, help='Bandwidth of each connection in KiB/s')
+    parser.add_argument('-m', '--max-connections', type=int, default=0, help='Answer 503 above this many downloads')
+    args = parser.parse_args()
+
+    server = http.server.ThreadingHTTPServer(('127.0.0.1', args.port), Handler)
+    server.daemon_threads = True
+    server.root = os.path.abspath(args.root)
+    server.limits = Limits(args.total * 1024, args.connection * 1024, args.max_connections)
+    if args.script:
+        threading.Thread(target=run_script, args=(server.limits, args.script), daemon=True).start()
+    print('Serving %s on port %d' % (server.root, args.port), file=sys.stderr)
+    server.serve_forever()
+
+
+if __name__ == '__main__':
+    main()